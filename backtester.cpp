@@ -2,52 +2,56 @@
 #include <fstream>
 #include <string>
 #include <vector>
+#include <deque>
 #include <algorithm>
 #include <charconv>
 #include <simdjson.h>
 #include <memory_resource>
+#include <memory>
 #include <array>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <type_traits>
+#include <filesystem>
+#include <thread>
+#include <atomic>
+#include "order_book.hpp"
+#include "book_validator.hpp"
+#include "recording.hpp"
+#include "features.hpp"
+#include "config.hpp"
 
-// --- 1. CORE LOGIC (Same as OrderBookEngine) ---
-struct Level { double price; double quantity; };
+// --- 1. FEE SCHEDULE ---
+// Volume-tiered maker/taker fees in basis points. A negative maker fee is a rebate.
+// Cumulative volume only grows, so the active tier is advanced lazily in O(1).
+struct FeeTier {
+    double min_volume; // cumulative USD notional needed to reach this tier
+    double maker_bps;
+    double taker_bps;
+};
 
-double fast_atof(std::string_view str) {
-    double result;
-    auto [ptr, ec] = std::from_chars(str.data(), str.data() + str.size(), result);
-    if (ec != std::errc()) return 0.0;
-    return result;
-}
+class FeeSchedule {
+public:
+    static constexpr int MAX_TIERS = 8;
 
-class OrderBook {
-private:
-    std::pmr::vector<Level> bids; 
-    std::pmr::vector<Level> asks;
+    FeeSchedule() : FeeSchedule({{ {0.0, 1.0, 4.0}, {1e6, 0.8, 3.5}, {5e6, 0.0, 3.0}, {25e6, -0.5, 2.5} }}, 4) {}
 
-public:
-    OrderBook(std::pmr::memory_resource* pool) : bids(pool), asks(pool) {
-        bids.reserve(5000); asks.reserve(5000);
-    }
-    void update_bid(double price, double qty) {
-        auto it = std::lower_bound(bids.begin(), bids.end(), price, [](const Level& l, double val) { return l.price > val; });
-        if (it != bids.end() && it->price == price) {
-            if (qty <= 1e-7) bids.erase(it); else it->quantity = qty;
-        } else if (qty > 1e-7) bids.insert(it, {price, qty});
-    }
-    void update_ask(double price, double qty) {
-        auto it = std::lower_bound(asks.begin(), asks.end(), price, [](const Level& l, double val) { return l.price < val; });
-        if (it != asks.end() && it->price == price) {
-            if (qty <= 1e-7) asks.erase(it); else it->quantity = qty;
-        } else if (qty > 1e-7) asks.insert(it, {price, qty});
-    }
-    double get_imbalance() {
-        if (bids.empty() || asks.empty()) return 0.5;
-        double b=0, a=0;
-        for(size_t i=0; i<std::min((size_t)5, bids.size()); ++i) b+=bids[i].quantity;
-        for(size_t i=0; i<std::min((size_t)5, asks.size()); ++i) a+=asks[i].quantity;
-        return b/(b+a);
-    }
-    double get_best_bid() { return bids.empty() ? 0.0 : bids[0].price; }
-    double get_best_ask() { return asks.empty() ? 0.0 : asks[0].price; }
+    FeeSchedule(std::array<FeeTier, MAX_TIERS> t, int n) : tiers(t), tier_count(std::clamp(n, 1, MAX_TIERS)) {}
+
+    static FeeSchedule flat(double maker_bps, double taker_bps) {
+        return FeeSchedule({{ {0.0, maker_bps, taker_bps} }}, 1);
+    }
+
+    const FeeTier& tier_for(double volume) {
+        while (current + 1 < tier_count && volume >= tiers[current + 1].min_volume) current++;
+        return tiers[current];
+    }
+
+private:
+    std::array<FeeTier, MAX_TIERS> tiers;
+    int tier_count;
+    int current = 0;
 };
 
 // --- 2. VIRTUAL WALLET ---
@@ -56,89 +60,974 @@ public:
     double usd_balance = 10000.0; 
     double btc_balance = 0.0;
     int trade_count = 0;
+    int rejected_count = 0;
+    double volume = 0.0;         // cumulative notional, drives the fee tier
+    double fees_paid = 0.0;      // net of rebates
+    double slippage_cost = 0.0;  // VWAP vs touch, in USD
 
-    void execute(const std::string& side, double price, double quantity) {
-        if (side == "BUY") {
-            usd_balance -= (price * quantity);
-            btc_balance += quantity;
-        } else {
-            usd_balance += (price * quantity);
-            btc_balance -= quantity;
+    FeeSchedule fees;
+    double max_short = 0.0;      // BTC the account may be short; 0 = spot only
+    bool model_slippage = true;
+    bool passive = false;        // strategy entries join their own side (see enter)
+
+    struct Fill { bool ok; double price; double fee; };
+
+    // Aggressive order: crosses the spread and pays the taker fee. With slippage
+    // enabled the price is the VWAP of walking the current levels of `depth`
+    // (an OrderBook, or a MarketFrame from the walk-forward tape).
+    template <class Depth>
+    Fill execute_taker(Side side, const Depth& depth, double touch_price, double quantity) {
+        double notional = touch_price * quantity;
+        if (model_slippage) {
+            auto s = depth.sweep(side, quantity);
+            if (s.filled < quantity) { rejected_count++; return {false, 0.0, 0.0}; }
+            notional = s.notional;
         }
-        trade_count++;
+        double price = notional / quantity;
+        double fee = notional * fees.tier_for(volume).taker_bps * 1e-4;
+        if (!settle(side, notional, quantity, fee)) return {false, 0.0, 0.0};
+        slippage_cost += std::abs(price - touch_price) * quantity;
+        return {true, price, fee};
+    }
+
+    // Passive order assumed filled at its limit price; earns the maker rate.
+    Fill execute_maker(Side side, double price, double quantity) {
+        double notional = price * quantity;
+        double fee = notional * fees.tier_for(volume).maker_bps * 1e-4;
+        if (!settle(side, notional, quantity, fee)) return {false, 0.0, 0.0};
+        return {true, price, fee};
+    }
+
+    // Strategy entry on `depth` (an OrderBook or a MarketFrame). Passive, like the
+    // live engine: a limit order joining our own side of the book, assumed filled
+    // at that price. Otherwise it crosses the spread at the opposite touch.
+    template <class Depth>
+    Fill enter(Side side, const Depth& depth, double quantity) {
+        if (passive) return execute_maker(side, depth.get_best(side), quantity);
+        return execute_taker(side, depth, depth.get_best(opposite_side(side)), quantity);
     }
 
     double get_total_equity(double current_price) {
         return usd_balance + (btc_balance * current_price);
     }
+
+private:
+    bool settle(Side side, double notional, double quantity, double fee) {
+        double usd_after = usd_balance - side_sign(side) * notional - fee;
+        double btc_after = btc_balance + side_sign(side) * quantity;
+        if (usd_after < 0.0 || btc_after < -max_short - 1e-12) {
+            rejected_count++;
+            return false;
+        }
+        usd_balance = usd_after;
+        btc_balance = btc_after;
+        volume += notional;
+        fees_paid += fee;
+        trade_count++;
+        return true;
+    }
+};
+
+// --- 3. PERFORMANCE STATISTICS ---
+// Streaming accumulators: every hook is O(1) and allocation-free except the
+// equity curve, which is sampled once per period into a pre-reserved vector.
+class PerformanceStats {
+public:
+    static constexpr int INVENTORY_BUCKETS = 21; // -10..+10 lots around flat
+
+    PerformanceStats(double start_equity, double lot_size, long long period_len)
+        : start_equity(start_equity), peak_equity(start_equity), last_equity(start_equity),
+          period_start_equity(start_equity), lot_size(lot_size), period_len(period_len) {
+        curve.reserve(1 << 16);
+    }
+
+    // Called once per replayed update with the current mark-to-market state.
+    void on_tick(double equity, double position) {
+        ticks++;
+        last_equity = equity;
+
+        if (equity > peak_equity) peak_equity = equity;
+        double dd = peak_equity - equity;
+        if (dd > max_drawdown) {
+            max_drawdown = dd;
+            max_drawdown_pct = dd / peak_equity;
+        }
+
+        // Little's law: time-integral of |inventory| / quantity closed = avg holding time
+        inventory_integral += std::abs(position);
+        int bucket = (int)std::lround(position / lot_size) + INVENTORY_BUCKETS / 2;
+        bucket = std::clamp(bucket, 0, INVENTORY_BUCKETS - 1);
+        inventory_hist[bucket]++;
+
+        if (ticks % period_len == 0) close_period();
+    }
+
+    void on_fill(Side side, double price, double quantity, double fee, double position_before) {
+        double notional = price * quantity;
+        turnover += notional;
+        fees += fee;
+        fill_count[side_index(side)]++;
+        fill_qty[side_index(side)] += quantity;
+
+        // Portion of the fill that reduces existing inventory counts as closed
+        double signed_qty = side_sign(side) * quantity;
+        if (position_before * signed_qty < 0) closed_qty += std::min(std::abs(position_before), quantity);
+    }
+
+    void print() const {
+        std::cout << "Max Drawdown:      $" << max_drawdown << " (" << max_drawdown_pct * 100.0 << "%)" << std::endl;
+        std::cout << "Sharpe (per-period): " << sharpe() << " over " << periods << " periods of " << period_len << " updates" << std::endl;
+        std::cout << "Turnover:          $" << turnover << " (" << turnover / start_equity << "x equity)" << std::endl;
+        std::cout << "Fills (Buy/Sell):  " << fill_count[side_index(Side::BUY)] << " / " << fill_count[side_index(Side::SELL)] << std::endl;
+        std::cout << "Avg Holding Time:  " << avg_holding_time() << " updates" << std::endl;
+    }
+
+    bool write_csv(const char* path) const {
+        std::ofstream out(path);
+        if (!out.is_open()) return false;
+        out.precision(12);
+        out << "period,update,equity,return\n";
+        for (size_t i = 0; i < curve.size(); i++) {
+            out << i << ',' << (long long)(i + 1) * period_len << ',' << curve[i].equity << ',' << curve[i].ret << '\n';
+        }
+        return true;
+    }
+
+    bool write_json(const char* path, double end_equity) const {
+        std::ofstream out(path);
+        if (!out.is_open()) return false;
+        out.precision(12);
+        out << "{\n";
+        out << "  \"updates\": " << ticks << ",\n";
+        out << "  \"start_equity\": " << start_equity << ",\n";
+        out << "  \"end_equity\": " << end_equity << ",\n";
+        out << "  \"net_pnl\": " << end_equity - start_equity << ",\n";
+        out << "  \"max_drawdown\": " << max_drawdown << ",\n";
+        out << "  \"max_drawdown_pct\": " << max_drawdown_pct << ",\n";
+        out << "  \"periods\": " << periods << ",\n";
+        out << "  \"period_len\": " << period_len << ",\n";
+        out << "  \"mean_return\": " << ret_mean << ",\n";
+        out << "  \"stddev_return\": " << stddev() << ",\n";
+        out << "  \"sharpe\": " << sharpe() << ",\n";
+        out << "  \"turnover\": " << turnover << ",\n";
+        out << "  \"fees\": " << fees << ",\n";
+        out << "  \"buys\": " << fill_count[side_index(Side::BUY)] << ",\n";
+        out << "  \"sells\": " << fill_count[side_index(Side::SELL)] << ",\n";
+        out << "  \"buy_qty\": " << fill_qty[side_index(Side::BUY)] << ",\n";
+        out << "  \"sell_qty\": " << fill_qty[side_index(Side::SELL)] << ",\n";
+        out << "  \"avg_holding_time\": " << avg_holding_time() << ",\n";
+        out << "  \"inventory_lot_size\": " << lot_size << ",\n";
+        out << "  \"inventory_histogram\": [";
+        for (int i = 0; i < INVENTORY_BUCKETS; i++) {
+            out << (i ? ", " : "") << (ticks ? (double)inventory_hist[i] / ticks : 0.0);
+        }
+        out << "]\n}\n";
+        return true;
+    }
+
+private:
+    struct CurvePoint { double equity; double ret; };
+
+    void close_period() {
+        double ret = period_start_equity != 0 ? (last_equity - period_start_equity) / period_start_equity : 0.0;
+        period_start_equity = last_equity;
+        curve.push_back({last_equity, ret});
+
+        // Welford's online mean/variance
+        periods++;
+        double delta = ret - ret_mean;
+        ret_mean += delta / periods;
+        ret_m2 += delta * (ret - ret_mean);
+    }
+
+    double stddev() const { return periods > 1 ? std::sqrt(ret_m2 / (periods - 1)) : 0.0; }
+    double sharpe() const { double sd = stddev(); return sd > 0 ? ret_mean / sd : 0.0; }
+    double avg_holding_time() const { return closed_qty > 0 ? inventory_integral / closed_qty : 0.0; }
+
+    double start_equity;
+    double peak_equity;
+    double last_equity;
+    double period_start_equity;
+    double lot_size;
+    long long period_len;
+
+    long long ticks = 0;
+    double max_drawdown = 0.0;
+    double max_drawdown_pct = 0.0;
+
+    long long periods = 0;
+    double ret_mean = 0.0;
+    double ret_m2 = 0.0;
+
+    double turnover = 0.0;
+    double fees = 0.0;
+    std::array<int, 2> fill_count{};    // indexed by Side
+    std::array<double, 2> fill_qty{};
+    double closed_qty = 0.0;
+    double inventory_integral = 0.0;
+    std::array<long long, INVENTORY_BUCKETS> inventory_hist{};
+
+    std::vector<CurvePoint> curve;
 };
 
-// --- 3. MAIN SIMULATION ---
-int main() {
-    alignas(std::max_align_t) std::array<std::byte, 1024*1024> buf;
-    std::pmr::monotonic_buffer_resource pool{buf.data(), buf.size()};
+// --- 4. REPLAY CLOCK ---
+// Maps event time onto wall time at `speed`x. speed <= 0 replays as fast as possible.
+class ReplayPacer {
+public:
+    explicit ReplayPacer(double speed) : speed(speed) {}
+
+    void wait_for(long long event_ns) {
+        if (speed <= 0 || event_ns <= 0) return;
+        auto now = std::chrono::steady_clock::now();
+        if (first_event_ns == 0) {
+            first_event_ns = event_ns;
+            wall_start = now;
+            return;
+        }
+        auto target = due_at(event_ns);
+        // Sleep through long gaps, spin the last stretch for sub-scheduler accuracy
+        if (target - now > SPIN_WINDOW) std::this_thread::sleep_until(target - SPIN_WINDOW);
+        while (std::chrono::steady_clock::now() < target) {}
+    }
+
+    // True once the wall clock has passed the time `event_ns` would have arrived.
+    bool due(long long event_ns) const {
+        if (speed <= 0 || event_ns <= 0 || first_event_ns == 0) return false;
+        return std::chrono::steady_clock::now() >= due_at(event_ns);
+    }
+
+private:
+    std::chrono::steady_clock::time_point due_at(long long event_ns) const {
+        return wall_start + std::chrono::nanoseconds((long long)((event_ns - first_event_ns) / speed));
+    }
+
+    static constexpr std::chrono::microseconds SPIN_WINDOW{200};
+    double speed;
+    long long first_event_ns = 0;
+    std::chrono::steady_clock::time_point wall_start;
+};
+
+// Reads ahead of the paced replay while records are already due, so the replay
+// sees the same queue a live consumer would find behind each message. Disabled
+// (pending() == 0, no read-ahead) when the pacer does not run on receive time.
+class ArrivalQueue {
+public:
+    ArrivalQueue(RecordingReader& reader, const ReplayPacer& pacer, bool enabled)
+        : reader(reader), pacer(pacer), enabled(enabled) {}
+
+    bool next(std::string_view& line) {
+        if (queue.empty()) return reader.next(line);
+        current = std::move(queue.front());
+        queue.pop_front();
+        line = current;
+        return true;
+    }
+
+    // Records that have arrived but not been replayed yet. Invalidates the last line from next().
+    size_t pending() {
+        if (!enabled) return 0;
+        std::string_view line;
+        while (!exhausted && (queue.empty() || arrived(queue.back()))) {
+            if (!reader.next(line)) { exhausted = true; break; }
+            queue.emplace_back(line);
+            // Keeps padded lines parseable in place once they leave the block buffer
+            queue.back().reserve(line.size() + simdjson::SIMDJSON_PADDING);
+        }
+        return queue.size() - (!queue.empty() && !arrived(queue.back()));
+    }
+
+private:
+    bool arrived(std::string_view line) const {
+        std::string_view json;
+        return pacer.due(split_record(line, json));
+    }
+
+    RecordingReader& reader;
+    const ReplayPacer& pacer;
+    bool enabled;
+    bool exhausted = false;
+    std::deque<std::string> queue;
+    std::string current;
+};
+
+// --- 5. RECORD DECODING ---
+// Applies one recorded line to the book. Shared by the replay loop and the
+// checkpoint index builder so both see exactly the same book.
+enum class RecordKind { SKIP, SNAPSHOT, CHECKPOINT, UPDATE };
+
+struct DecodedRecord {
+    RecordKind kind;
+    long long event_ns;  // 0 when the record carries no usable time
+    long long update_id; // last update ID covered by the book after this record
+    int levels;          // price levels carried by an UPDATE
+};
+
+class RecordDecoder {
+public:
+    RecordDecoder(bool padded, bool exchange_clock, bool need_time)
+        : padded(padded), exchange_clock(exchange_clock), need_time(need_time) {}
+
+    // `observer` (optional) hears about changes in its top-of-book window; a
+    // snapshot counts as a change everywhere.
+    template <class Observer = std::nullptr_t>
+    DecodedRecord apply(std::string_view line, OrderBook& book, BookValidator& validator, Observer* observer = nullptr) {
+        std::string_view json;
+        long long recv_ns = split_record(line, json);
+        // Block buffers are padded, so their lines parse in place without a copy
+        simdjson::dom::element doc = parser.parse(json.data(), json.size(), !padded);
+
+        // Recorder metadata: exchange snapshots (resync points) and verified checkpoints
+        if (json.starts_with("{\"lastUpdateId\"")) {
+            simdjson::dom::array snap_bids = doc["bids"];
+            simdjson::dom::array snap_asks = doc["asks"];
+            book.load_snapshot(snap_bids, snap_asks, false);
+            int64_t snapshot_id = doc["lastUpdateId"];
+            if (validator.updates == 0) validator.start(snapshot_id);
+            else validator.on_resync(snapshot_id);
+            if constexpr (!std::is_null_pointer_v<Observer>) observer->on_book_change(BookChange::all());
+            return {RecordKind::SNAPSHOT, exchange_clock ? 0 : recv_ns, snapshot_id, 0};
+        }
+        if (json.starts_with("{\"chk\"")) {
+            validator.offer({int64_t(doc["chk"]["u"]), uint64_t(doc["chk"]["crc"])});
+            return {RecordKind::CHECKPOINT, exchange_clock ? 0 : recv_ns, validator.get_last_update_id(), 0};
+        }
+
+        // Legacy recordings have no receive time; fall back to exchange time (ms)
+        long long event_ns = recv_ns;
+        if (need_time && (exchange_clock || recv_ns == 0)) {
+            int64_t event_ms = 0;
+            event_ns = (doc["E"].get(event_ms) == simdjson::SUCCESS) ? event_ms * 1000000 : 0;
+        }
+
+        int64_t first_id = doc["U"];
+        int64_t last_id = doc["u"];
+        if (!validator.should_apply(last_id)) return {RecordKind::SKIP, event_ns, last_id, 0};
+
+        simdjson::dom::array bids = doc["b"];
+        simdjson::dom::array asks = doc["a"];
+
+        parse_levels(bids, bid_changes);
+        parse_levels(asks, ask_changes);
+        int levels = int(bid_changes.size() + ask_changes.size());
+        if constexpr (std::is_null_pointer_v<Observer>) book.apply_update(bid_changes, ask_changes);
+        else book.apply_update(bid_changes, ask_changes, *observer);
+
+        // Invalid states are counted; the recording carries the live engine's resync snapshot
+        validator.on_update(book, first_id, last_id);
+        return {RecordKind::UPDATE, event_ns, last_id, levels};
+    }
+
+private:
+    simdjson::dom::parser parser;
+    std::vector<Level> bid_changes, ask_changes;
+    bool padded;
+    bool exchange_clock;
+    bool need_time;
+};
+
+// --- 6. REPLAY CHECKPOINTS ---
+// Sparse seek index for windowed replay, built on the first --from/--to run over
+// a recording: every `interval` of market time the full book is written to
+// "<input>.ckpt" together with the reader position of the next record. A later
+// window restores the last checkpoint before --from and replays only from there.
+struct CheckpointHeader {
+    uint32_t magic;
+    uint32_t n_bids;
+    uint32_t n_asks;
+    uint32_t reserved;
+    int64_t event_ns;
+    int64_t update_id;
+    uint64_t position;   // RecordingReader::tell() of the record after the checkpoint
+};
+static_assert(sizeof(CheckpointHeader) == 40);
+
+class CheckpointIndex {
+public:
+    static constexpr uint32_t MAGIC = 0x4B434648; // "HFCK"
+
+    static std::string path_for(const std::string& input) { return input + ".ckpt"; }
+
+    // Loads the index unless it is missing or older than the recording.
+    bool load(const std::string& input) {
+        std::error_code ec;
+        auto ckpt = path_for(input);
+        if (!std::filesystem::exists(ckpt, ec)) return false;
+        if (std::filesystem::last_write_time(ckpt, ec) < std::filesystem::last_write_time(input, ec)) return false;
+
+        file.open(ckpt, std::ios::binary);
+        CheckpointHeader h;
+        uint64_t off = 0;
+        while (file.read(reinterpret_cast<char*>(&h), sizeof(h)) && h.magic == MAGIC) {
+            entries.push_back({h, off});
+            off += sizeof(h) + (uint64_t)(h.n_bids + h.n_asks) * sizeof(Level);
+            file.seekg(off);
+        }
+        file.clear();
+        return true;
+    }
+
+    // One book-only pass over the recording (no strategy, no pacing).
+    static bool build(const std::string& input, long long interval_ns) {
+        RecordingReader reader;
+        if (!reader.open(input)) return false;
+        std::ofstream out(path_for(input), std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) return false;
+
+        OrderBook book(std::pmr::new_delete_resource());
+        BookValidator validator;
+        RecordDecoder decoder(reader.padded(), false, true);
+        long long next_ns = 0;
+        long long written = 0;
+        std::string_view line;
+        while (reader.next(line)) {
+            if (line.empty()) continue;
+            DecodedRecord r;
+            try {
+                r = decoder.apply(line, book, validator);
+            } catch (const simdjson::simdjson_error&) {
+                continue;
+            }
+            if (r.kind != RecordKind::UPDATE || r.event_ns == 0) continue;
+            if (next_ns == 0) next_ns = r.event_ns + interval_ns;
+            if (r.event_ns < next_ns) continue;
+            next_ns = r.event_ns + interval_ns;
+
+            const auto& b = book.bid_levels();
+            const auto& a = book.ask_levels();
+            CheckpointHeader h{MAGIC, (uint32_t)b.size(), (uint32_t)a.size(), 0, r.event_ns, r.update_id, reader.tell()};
+            out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+            out.write(reinterpret_cast<const char*>(b.data()), b.size() * sizeof(Level));
+            out.write(reinterpret_cast<const char*>(a.data()), a.size() * sizeof(Level));
+            written++;
+        }
+        std::cout << "[INDEX] Wrote " << written << " book checkpoints to " << path_for(input) << std::endl;
+        return true;
+    }
+
+    // Latest checkpoint strictly before the window start (time or update ID); -1 if none.
+    int find(long long from_ns, long long from_id) const {
+        int best = -1;
+        for (size_t i = 0; i < entries.size(); i++) {
+            const CheckpointHeader& h = entries[i].header;
+            if ((from_ns && h.event_ns >= from_ns) || (from_id && h.update_id >= from_id)) break;
+            best = (int)i;
+        }
+        return best;
+    }
+
+    const CheckpointHeader& header(int i) const { return entries[i].header; }
+
+    bool restore(int i, OrderBook& book) {
+        const Entry& e = entries[i];
+        std::vector<Level> bids(e.header.n_bids), asks(e.header.n_asks);
+        file.seekg(e.offset + sizeof(CheckpointHeader));
+        file.read(reinterpret_cast<char*>(bids.data()), bids.size() * sizeof(Level));
+        file.read(reinterpret_cast<char*>(asks.data()), asks.size() * sizeof(Level));
+        if (!file) return false;
+        book.restore(bids, asks);
+        return true;
+    }
+
+    size_t size() const { return entries.size(); }
+
+private:
+    struct Entry {
+        CheckpointHeader header;
+        uint64_t offset;
+    };
+
+    std::vector<Entry> entries;
+    std::ifstream file;
+};
+
+// --- 7. WALK-FORWARD OPTIMIZATION ---
+// The strategy's tunables. The production values come from EngineConfig.
+struct StrategyParams {
+    double buy_threshold;   // imbalance above which we lift the ask
+    double sell_threshold;  // imbalance below which we hit the bid
+    int cooldown;           // updates to wait after a fill
+    double trade_qty;
+
+    static StrategyParams from(const EngineConfig& c) {
+        return {c.hot.buy_threshold, c.hot.sell_threshold, c.backtest_cooldown, c.hot.trade_qty};
+    }
+};
+
+// What the strategy and wallet read from the book after one update. The
+// recording is decoded into a tape of these once; every train/test evaluation
+// then replays the tape without touching JSON or the OrderBook.
+constexpr size_t TAPE_DEPTH = 5;
+
+struct MarketFrame {
+    int64_t event_ns;
+    double imbalance;
+    std::array<Level, TAPE_DEPTH> bids; // best first, zero-filled past the book
+    std::array<Level, TAPE_DEPTH> asks;
+
+    double get_best(Side side) const { return (side == Side::BUY ? bids : asks)[0].price; }
+
+    // Same contract as OrderBook::sweep, limited to the captured depth
+    OrderBook::Sweep sweep(Side side, double qty) const {
+        OrderBook::Sweep s{0.0, 0.0};
+        for (const Level& l : side == Side::BUY ? asks : bids) {
+            double take = std::min(qty - s.filled, l.quantity);
+            s.filled += take;
+            s.notional += take * l.price;
+            if (s.filled >= qty) break;
+        }
+        return s;
+    }
+};
+
+std::vector<MarketFrame> build_tape(const std::string& input) {
+    std::vector<MarketFrame> tape;
+    RecordingReader reader;
+    if (!reader.open(input)) return tape;
+
+    OrderBook book(std::pmr::new_delete_resource());
+    BookValidator validator;
+    RecordDecoder decoder(reader.padded(), false, true);
+    std::string_view line;
+    while (reader.next(line)) {
+        if (line.empty()) continue;
+        DecodedRecord r;
+        try {
+            r = decoder.apply(line, book, validator);
+        } catch (const simdjson::simdjson_error&) {
+            continue;
+        }
+        if (r.kind != RecordKind::UPDATE || r.event_ns == 0) continue;
+
+        MarketFrame f{r.event_ns, book.get_imbalance(), {}, {}};
+        const auto& b = book.bid_levels();
+        const auto& a = book.ask_levels();
+        std::copy_n(b.begin(), std::min(TAPE_DEPTH, b.size()), f.bids.begin());
+        std::copy_n(a.begin(), std::min(TAPE_DEPTH, a.size()), f.asks.begin());
+        tape.push_back(f);
+    }
+    return tape;
+}
+
+struct WindowResult {
+    double pnl = 0.0;
+    int trades = 0;
+    double max_drawdown = 0.0;
+};
+
+// Runs the strategy over tape[begin, end) with a fresh wallet configured like `proto`.
+WindowResult evaluate(const std::vector<MarketFrame>& tape, size_t begin, size_t end,
+                      const StrategyParams& p, const BacktestWallet& proto) {
+    BacktestWallet wallet = proto;
+    double start = wallet.usd_balance;
+    double last_mid = 0.0, peak = start;
+    int cooldown = 0;
+    WindowResult res;
+
+    for (size_t i = begin; i < end; i++) {
+        const MarketFrame& f = tape[i];
+        double bid = f.bids[0].price, ask = f.asks[0].price;
+        if (cooldown > 0) cooldown--;
+        if (ask > bid && bid > 0) {
+            last_mid = (bid + ask) / 2.0;
+            if (cooldown == 0) {
+                if (f.imbalance > p.buy_threshold) {
+                    wallet.enter(Side::BUY, f, p.trade_qty);
+                    cooldown = p.cooldown;
+                } else if (f.imbalance < p.sell_threshold) {
+                    wallet.enter(Side::SELL, f, p.trade_qty);
+                    cooldown = p.cooldown;
+                }
+            }
+        }
+        double equity = wallet.get_total_equity(last_mid);
+        peak = std::max(peak, equity);
+        res.max_drawdown = std::max(res.max_drawdown, peak - equity);
+    }
+    res.pnl = wallet.get_total_equity(last_mid) - start;
+    res.trades = wallet.trade_count;
+    return res;
+}
+
+// Rolling windows: optimise on [t, t+train), trade the winner on [t+train, t+train+test), step by test.
+int run_walk_forward(const std::string& input, const BacktestWallet& proto, double trade_qty,
+                     long long train_ns, long long test_ns, unsigned threads) {
+    auto t0 = std::chrono::steady_clock::now();
+    std::vector<MarketFrame> tape = build_tape(input);
+    auto t1 = std::chrono::steady_clock::now();
+    if (tape.empty()) {
+        std::cerr << "Error: no timestamped updates in " << input << std::endl;
+        return 1;
+    }
+    std::cout << "[WALK-FORWARD] Decoded " << tape.size() << " frames in "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(t1 - t0).count() << " ms" << std::endl;
+
+    std::vector<StrategyParams> grid;
+    for (double buy : {0.6, 0.65, 0.7, 0.75, 0.8, 0.85, 0.9}) {
+        for (int cooldown : {25, 50, 100, 200, 500}) {
+            grid.push_back({buy, 1.0 - buy, cooldown, trade_qty});
+        }
+    }
+
+    auto index_at = [&](long long ts) {
+        return (size_t)(std::lower_bound(tape.begin(), tape.end(), ts,
+            [](const MarketFrame& f, long long t) { return f.event_ns < t; }) - tape.begin());
+    };
+
+    struct Window { size_t train_begin, train_end, test_end; int best = -1; WindowResult train{}, test{}; };
+    std::vector<Window> windows;
+    for (long long t = tape.front().event_ns; t + train_ns + test_ns <= tape.back().event_ns; t += test_ns) {
+        windows.push_back({.train_begin = index_at(t), .train_end = index_at(t + train_ns),
+                           .test_end = index_at(t + train_ns + test_ns)});
+    }
+    if (windows.empty()) {
+        std::cerr << "Error: recording shorter than one train+test window" << std::endl;
+        return 1;
+    }
+
+    // Every (window, candidate) train run is independent: hand them out via an atomic cursor
+    std::vector<WindowResult> train_results(windows.size() * grid.size());
+    std::atomic<size_t> next{0};
+    auto worker = [&] {
+        for (size_t job; (job = next.fetch_add(1)) < train_results.size();) {
+            const Window& w = windows[job / grid.size()];
+            train_results[job] = evaluate(tape, w.train_begin, w.train_end, grid[job % grid.size()], proto);
+        }
+    };
+    std::vector<std::thread> pool;
+    for (unsigned i = 0; i < std::max(1u, threads); i++) pool.emplace_back(worker);
+    for (auto& t : pool) t.join();
+
+    double oos_pnl = 0.0;
+    int oos_trades = 0, positive = 0;
+    for (size_t wi = 0; wi < windows.size(); wi++) {
+        Window& w = windows[wi];
+        for (size_t g = 0; g < grid.size(); g++) {
+            const WindowResult& r = train_results[wi * grid.size() + g];
+            if (w.best < 0 || r.pnl > w.train.pnl) { w.best = (int)g; w.train = r; }
+        }
+        w.test = evaluate(tape, w.train_end, w.test_end, grid[w.best], proto);
+        oos_pnl += w.test.pnl;
+        oos_trades += w.test.trades;
+        if (w.test.pnl > 0) positive++;
+    }
+    auto t2 = std::chrono::steady_clock::now();
+
+    std::ofstream csv("walk_forward.csv");
+    csv.precision(12);
+    csv << "window,train_start_ns,test_start_ns,test_end_ns,buy_threshold,sell_threshold,cooldown,train_pnl,train_trades,test_pnl,test_trades,test_max_drawdown\n";
+    std::cout << "\n=== WALK-FORWARD RESULTS ===" << std::endl;
+    for (size_t wi = 0; wi < windows.size(); wi++) {
+        const Window& w = windows[wi];
+        const StrategyParams& p = grid[w.best];
+        std::cout << "Window " << wi << ": buy>" << p.buy_threshold << " sell<" << p.sell_threshold << " cd=" << p.cooldown
+                  << " | train $" << w.train.pnl << " (" << w.train.trades << ")"
+                  << " | test $" << w.test.pnl << " (" << w.test.trades << ")" << std::endl;
+        csv << wi << ',' << tape[w.train_begin].event_ns << ',' << tape[w.train_end].event_ns << ','
+            << tape[std::min(w.test_end, tape.size() - 1)].event_ns << ',' << p.buy_threshold << ',' << p.sell_threshold << ','
+            << p.cooldown << ',' << w.train.pnl << ',' << w.train.trades << ',' << w.test.pnl << ',' << w.test.trades << ','
+            << w.test.max_drawdown << '\n';
+    }
+    std::cout << "Windows:           " << windows.size() << " (" << grid.size() << " candidates each)" << std::endl;
+    std::cout << "Out-of-Sample PnL: $" << oos_pnl << " ($" << oos_pnl / windows.size() << " per window)" << std::endl;
+    std::cout << "OOS Trades:        " << oos_trades << std::endl;
+    std::cout << "Positive Windows:  " << positive << " / " << windows.size() << std::endl;
+    std::cout << "Search Time:       " << std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1).count()
+              << " ms on " << std::max(1u, threads) << " threads" << std::endl;
+    std::cout << "============================" << std::endl;
+    return 0;
+}
+
+// --- 8. FEATURE EXTRACTION ---
+// Replays each recording through the OrderBook and writes one feature row per
+// update to "<out_dir>/<file name>.hftc". Files are independent, so they are spread
+// across worker threads.
+int run_feature_extraction(const std::vector<std::string>& inputs, const std::string& out_dir, unsigned threads) {
+    std::error_code ec;
+    std::filesystem::create_directories(out_dir, ec);
+    auto start = std::chrono::steady_clock::now();
+    std::atomic<size_t> next{0};
+    std::atomic<size_t> total_rows{0};
+    std::atomic<int> failures{0};
+
+    auto worker = [&] {
+        for (size_t i; (i = next.fetch_add(1)) < inputs.size();) {
+            const std::string& input = inputs[i];
+            std::string out_path = (std::filesystem::path(out_dir) / std::filesystem::path(input).filename()).string() + ".hftc";
+            RecordingReader reader;
+            ColumnarWriter writer;
+            if (!reader.open(input) || !writer.open(out_path, FeatureExtractor::column_names())) {
+                std::cerr << "[FEATURES] Cannot process " << input << std::endl;
+                failures++;
+                continue;
+            }
+
+            OrderBook book(std::pmr::new_delete_resource());
+            BookValidator validator;
+            RecordDecoder decoder(reader.padded(), false, true);
+            FeatureExtractor extractor;
+            std::string_view line;
+            while (reader.next(line)) {
+                if (line.empty()) continue;
+                try {
+                    DecodedRecord r = decoder.apply(line, book, validator);
+                    if (r.kind == RecordKind::UPDATE) extractor.extract(book, r.event_ns, r.update_id, r.levels, writer);
+                } catch (const simdjson::simdjson_error&) {
+                    continue;
+                }
+            }
+            writer.close();
+            total_rows += writer.row_count();
+            std::cout << "[FEATURES] " << input << " -> " << out_path << " (" << writer.row_count() << " rows)" << std::endl;
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (unsigned i = 0; i < std::min<size_t>(std::max(1u, threads), inputs.size()); i++) pool.emplace_back(worker);
+    for (auto& t : pool) t.join();
+
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "[FEATURES] " << total_rows << " rows from " << inputs.size() << " files in " << ms << " ms" << std::endl;
+    return failures ? 1 : 0;
+}
+
+// --- 9. MAIN SIMULATION ---
+int main(int argc, char** argv) {
+    bool stats_enabled = true;
+    long long period_len = 1000;
+    double maker_bps = NAN, taker_bps = NAN; // unset = default tiered schedule
+    double max_short = 0.0;
+    bool model_slippage = true;
+    bool passive = false;          // enter like the live engine: join own side at the maker rate
+    double speed = 0.0;            // 0 = as fast as possible, 1 = real time, 10 = 10x
+    bool exchange_clock = false;   // pace on exchange "E" instead of local receive time
+    bool conflate = false;         // paced replay: skip the strategy while records are queued
+    std::string input_path;
+    long long from_ns = 0, to_ns = 0;       // replay window in recorded time (0 = open)
+    long long from_id = 0, to_id = 0;       // ... or in exchange update IDs
+    long long checkpoint_interval_s = 60;
+    bool build_index = false;
+    bool walk_forward = false;
+    long long train_s = 3600, test_s = 900;
+    unsigned threads = std::thread::hardware_concurrency();
+    std::string features_dir;              // extract features instead of trading
+    std::vector<std::string> extra_inputs; // positional arguments: more recordings
+    std::string convert_path;      // re-encode the input instead of replaying it
+    Codec convert_codec = Codec::ZSTD;
+    std::string config_path;       // strategy/backtest values, see config.hpp
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--config") == 0 && i + 1 < argc) config_path = argv[++i];
+        else if (std::strcmp(argv[i], "--no-stats") == 0) stats_enabled = false;
+        else if (std::strcmp(argv[i], "--period") == 0 && i + 1 < argc) period_len = std::max(1LL, std::atoll(argv[++i]));
+        else if (std::strcmp(argv[i], "--maker-bps") == 0 && i + 1 < argc) maker_bps = std::atof(argv[++i]);
+        else if (std::strcmp(argv[i], "--taker-bps") == 0 && i + 1 < argc) taker_bps = std::atof(argv[++i]);
+        else if (std::strcmp(argv[i], "--max-short") == 0 && i + 1 < argc) max_short = std::atof(argv[++i]);
+        else if (std::strcmp(argv[i], "--no-slippage") == 0) model_slippage = false;
+        else if (std::strcmp(argv[i], "--passive") == 0) passive = true;
+        else if (std::strcmp(argv[i], "--speed") == 0 && i + 1 < argc) speed = std::atof(argv[++i]);
+        else if (std::strcmp(argv[i], "--exchange-clock") == 0) exchange_clock = true;
+        else if (std::strcmp(argv[i], "--conflate") == 0) conflate = true;
+        else if (std::strcmp(argv[i], "--input") == 0 && i + 1 < argc) input_path = argv[++i];
+        else if (std::strcmp(argv[i], "--from") == 0 && i + 1 < argc) from_ns = std::atoll(argv[++i]);
+        else if (std::strcmp(argv[i], "--to") == 0 && i + 1 < argc) to_ns = std::atoll(argv[++i]);
+        else if (std::strcmp(argv[i], "--from-update") == 0 && i + 1 < argc) from_id = std::atoll(argv[++i]);
+        else if (std::strcmp(argv[i], "--to-update") == 0 && i + 1 < argc) to_id = std::atoll(argv[++i]);
+        else if (std::strcmp(argv[i], "--checkpoint-interval") == 0 && i + 1 < argc) checkpoint_interval_s = std::max(1LL, std::atoll(argv[++i]));
+        else if (std::strcmp(argv[i], "--build-index") == 0) build_index = true;
+        else if (std::strcmp(argv[i], "--walk-forward") == 0) walk_forward = true;
+        else if (std::strcmp(argv[i], "--train") == 0 && i + 1 < argc) train_s = std::max(1LL, std::atoll(argv[++i]));
+        else if (std::strcmp(argv[i], "--test") == 0 && i + 1 < argc) test_s = std::max(1LL, std::atoll(argv[++i]));
+        else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc) threads = (unsigned)std::max(1, std::atoi(argv[++i]));
+        else if (std::strcmp(argv[i], "--convert") == 0 && i + 1 < argc) convert_path = argv[++i];
+        else if (std::strcmp(argv[i], "--codec") == 0 && i + 1 < argc) convert_codec = parse_codec(argv[++i]);
+        else if (std::strcmp(argv[i], "--features") == 0 && i + 1 < argc) features_dir = argv[++i];
+        else if (argv[i][0] != '-') extra_inputs.push_back(argv[i]);
+    }
+    if (input_path.empty()) input_path = std::filesystem::exists("market_data.rec") ? "market_data.rec" : "market_data.log";
+
+    EngineConfig loaded;
+    if (!config_path.empty() && !load_config(config_path, loaded)) return 1;
+    const EngineConfig& config = loaded;
+
+    if (!features_dir.empty()) {
+        if (extra_inputs.empty()) extra_inputs.push_back(input_path);
+        return run_feature_extraction(extra_inputs, features_dir, threads);
+    }
+
+    if (!std::filesystem::exists(input_path)) {
+        std::cerr << "Error: " << input_path << " not found inside build folder!" << std::endl;
+        return 1;
+    }
+
+    // Windowed replay: restore the nearest book checkpoint before the window and
+    // start reading there. The index is built by one book-only pass if missing.
+    bool windowed = from_ns || to_ns || from_id || to_id;
+    CheckpointIndex checkpoints;
+    if (build_index || (windowed && convert_path.empty())) {
+        if (build_index || !checkpoints.load(input_path)) {
+            if (!CheckpointIndex::build(input_path, checkpoint_interval_s * 1000000000LL)) {
+                std::cerr << "Error: failed to index " << input_path << std::endl;
+                return 1;
+            }
+            if (build_index) return 0;
+            checkpoints.load(input_path);
+        }
+    }
+    int start_checkpoint = windowed ? checkpoints.find(from_ns, from_id) : -1;
+
+    RecordingReader reader;
+    uint64_t start_position = start_checkpoint >= 0 ? checkpoints.header(start_checkpoint).position : 0;
+    if (!reader.open(input_path, convert_path.empty() ? 0 : from_ns, start_position)) {
+        std::cerr << "Error: cannot read " << input_path << std::endl;
+        return 1;
+    }
+
+    if (!convert_path.empty()) {
+        // Archive path: e.g. LZ4 live recordings -> zstd, or legacy text -> blocks
+        MarketRecorder out;
+        if (!out.open(convert_path, convert_codec, RecordMode::ARCHIVE)) {
+            std::cerr << "Error: cannot write " << convert_path << std::endl;
+            return 1;
+        }
+        std::string_view rec, json;
+        long long records = 0;
+        while (reader.next(rec)) {
+            if (rec.empty()) continue;
+            out.record(split_record(rec, json), json);
+            records++;
+        }
+        out.close();
+        std::cout << "[CONVERT] Wrote " << records << " records to " << convert_path << std::endl;
+        return 0;
+    }
+
+    auto buf = std::make_unique<std::byte[]>(config.arena_bytes);
+    std::pmr::monotonic_buffer_resource pool{buf.get(), config.arena_bytes};
     OrderBook book(&pool);
     BacktestWallet wallet;
+    if (!std::isnan(maker_bps) || !std::isnan(taker_bps)) {
+        wallet.fees = FeeSchedule::flat(std::isnan(maker_bps) ? 0.0 : maker_bps, std::isnan(taker_bps) ? 0.0 : taker_bps);
+    }
+    wallet.usd_balance = config.start_equity;
+    wallet.max_short = max_short;
+    wallet.model_slippage = model_slippage;
+    wallet.passive = passive;
 
-    std::ifstream log_file("market_data.log");
-    if (!log_file.is_open()) {
-        std::cerr << "Error: market_data.log not found inside build folder!" << std::endl;
-        return 1;
+    if (walk_forward) {
+        return run_walk_forward(input_path, wallet, config.hot.trade_qty, train_s * 1000000000LL, test_s * 1000000000LL, threads);
     }
 
+    const double start_equity = config.start_equity;
+    const StrategyParams params = StrategyParams::from(config);
+    PerformanceStats stats(start_equity, params.trade_qty, period_len);
+
     std::cout << "[BACKTEST] Starting simulation..." << std::endl;
-    std::string line;
-    simdjson::dom::parser parser;
+    std::string_view line;
     int cooldown = 0;
     int processed = 0;
+    int warmup = 0;
+    double last_mid = 0.0;
+    ReplayPacer pacer(speed);
+    BookValidator validator;
+    RecordDecoder decoder(reader.padded(), exchange_clock, speed > 0 || windowed);
+    StrategyTrigger<5> trigger; // the strategy reads the touch and get_imbalance()'s top 5
+    // Backlog is measured against recorded receive time, so only when pacing on it
+    ArrivalQueue arrivals(reader, pacer, speed > 0 && !exchange_clock);
+    BacklogMonitor backlog;
+    backlog.conflate = conflate;
+
+    if (start_checkpoint >= 0) {
+        const CheckpointHeader& h = checkpoints.header(start_checkpoint);
+        if (!checkpoints.restore(start_checkpoint, book)) {
+            std::cerr << "Error: corrupt checkpoint file " << CheckpointIndex::path_for(input_path) << std::endl;
+            return 1;
+        }
+        validator.start(h.update_id);
+        std::cout << "[BACKTEST] Restored checkpoint at u=" << h.update_id << " (" << h.n_bids << " bids, " << h.n_asks << " asks)" << std::endl;
+    }
+
+    auto fill = [&](Side side) {
+        double position_before = wallet.btc_balance;
+        auto f = wallet.enter(side, book, params.trade_qty);
+        if (f.ok && stats_enabled) stats.on_fill(side, f.price, params.trade_qty, f.fee, position_before);
+        cooldown = params.cooldown;
+    };
+
+    auto replay_start = std::chrono::steady_clock::now();
 
     // --- REPLAY LOOP ---
-    while (std::getline(log_file, line)) {
-        processed++;
+    while (arrivals.next(line)) {
         if (line.empty()) continue;
 
         try {
-            simdjson::dom::element doc = parser.parse(line);
-            simdjson::dom::array bids = doc["b"];
-            simdjson::dom::array asks = doc["a"];
+            DecodedRecord r = decoder.apply(line, book, validator, &trigger);
+            if (r.kind != RecordKind::UPDATE) continue;
 
-            for (auto l : bids) book.update_bid(fast_atof(l.at(0)), fast_atof(l.at(1)));
-            for (auto l : asks) book.update_ask(fast_atof(l.at(0)), fast_atof(l.at(1)));
+            if (windowed) {
+                if ((to_ns && r.event_ns > to_ns) || (to_id && r.update_id > to_id)) break;
+                // Book catches up from the checkpoint; the strategy only trades inside the window
+                if ((from_ns && r.event_ns < from_ns) || (from_id && r.update_id < from_id)) { warmup++; continue; }
+            }
+            processed++;
+            if (speed > 0) pacer.wait_for(r.event_ns);
+            bool run_stages = backlog.on_message(arrivals.pending(), std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count());
 
             if (cooldown > 0) cooldown--;
-            if (cooldown == 0 && book.get_best_ask() > book.get_best_bid()) {
-                double imb = book.get_imbalance();
-                double trade_qty = 0.002;
-
-                if (imb > 0.8) { 
-                    wallet.execute("BUY", book.get_best_ask(), trade_qty);
-                    cooldown = 100; 
-                } 
-                else if (imb < 0.2) { 
-                    wallet.execute("SELL", book.get_best_bid(), trade_qty);
-                    cooldown = 100;
+            if (book.get_best_ask() > book.get_best_bid() && book.get_best_bid() > 0) {
+                last_mid = (book.get_best_bid() + book.get_best_ask()) / 2.0;
+
+                // Skipped while nothing it reads has moved since it last did nothing
+                if (run_stages && cooldown == 0 && trigger.should_run()) {
+                    double imb = book.get_imbalance();
+                    if (imb > params.buy_threshold) fill(Side::BUY);
+                    else if (imb < params.sell_threshold) fill(Side::SELL);
+                    else trigger.dirty = false;
                 }
             }
+
+            if (stats_enabled) stats.on_tick(wallet.get_total_equity(last_mid), wallet.btc_balance);
         } catch (const simdjson::simdjson_error& e) {
-            std::cerr << "[WARNING] Skipping bad line #" << processed << std::endl;
+            std::cerr << "[WARNING] Skipping bad line #" << processed + warmup << std::endl;
             continue;
         }
     }
 
+    auto replay_end = std::chrono::steady_clock::now();
+    auto replay_ms = std::chrono::duration_cast<std::chrono::milliseconds>(replay_end - replay_start).count();
+
     // --- FINAL REPORT ---
-    double final_price = (book.get_best_bid() + book.get_best_ask()) / 2.0;
-    if (final_price == 0) final_price = 90000.0; // Fallback if book is empty
+    // Mark to the last uncrossed mid seen; an empty book means no fills were possible
+    double end_equity = wallet.get_total_equity(last_mid);
 
-    double start_equity = 10000.0;
-    double end_equity = wallet.get_total_equity(final_price);
-    
     std::cout << "\n=== BACKTEST RESULTS ===" << std::endl;
     std::cout << "Updates Processed: " << processed << std::endl;
+    if (windowed) std::cout << "Warm-up Updates:   " << warmup << " (from checkpoint to window start)" << std::endl;
     std::cout << "Trades Executed:   " << wallet.trade_count << std::endl;
+    std::cout << "Trades Rejected:   " << wallet.rejected_count << std::endl;
+    std::cout << "Fees (net):        $" << wallet.fees_paid << std::endl;
+    std::cout << "Slippage Cost:     $" << wallet.slippage_cost << std::endl;
     std::cout << "Starting Equity:   $" << start_equity << std::endl;
     std::cout << "Final Equity:      $" << end_equity << std::endl;
     std::cout << "Net PnL:           $" << (end_equity - start_equity) << std::endl;
+    if (stats_enabled) stats.print();
+    std::cout << "Strategy Runs:     " << trigger.runs << " (" << trigger.skipped << " skipped, top 5 unchanged)" << std::endl;
+    if (backlog.bursts) {
+        std::cout << "Backlog:           max " << backlog.max_pending << " records, " << backlog.backlogged << " behind, "
+                  << backlog.conflated << " conflated" << std::endl;
+        std::cout << "Catch-up:          " << backlog.bursts << " bursts, mean " << backlog.catchup_total_ns / backlog.bursts / 1000
+                  << " us, max " << backlog.catchup_max_ns / 1000 << " us" << std::endl;
+    }
+    std::cout << "Book Checks:       " << validator.verified << " verified, " << validator.divergences << " diverged, "
+              << validator.inconclusive << " inconclusive" << std::endl;
+    std::cout << "Book Anomalies:    " << validator.gaps << " gaps, " << validator.crossed << " crossed, "
+              << validator.locked << " locked, " << validator.resyncs << " resyncs" << std::endl;
+    std::cout << "Replay Time:       " << replay_ms << " ms (stats " << (stats_enabled ? "on" : "off") << ")" << std::endl;
     std::cout << "========================" << std::endl;
 
+    if (stats_enabled) {
+        if (!stats.write_csv("backtest_equity.csv")) std::cerr << "[WARNING] Failed to write backtest_equity.csv" << std::endl;
+        if (!stats.write_json("backtest_report.json", end_equity)) std::cerr << "[WARNING] Failed to write backtest_report.json" << std::endl;
+    }
+
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,99 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <cstring>
+#include <memory_resource>
+#include "order_book.hpp"
+#include "hybrid_book.hpp"
+
+// Book update cost versus book depth: the sorted-vector OrderBook against the
+// hot-window + B+tree HybridOrderBook. Each run seeds both books with the same
+// N levels per side, applies the same stream of inserts/modifies/deletes (mostly
+// near the touch, a share spread across the whole book) and cross-checks the
+// results with full-depth checksums.
+
+// --- 1. WORKLOAD ---
+struct Op {
+    bool bid;
+    double price;
+    double qty;
+};
+
+// Prices are integer ticks scaled once, so both books see bit-identical doubles.
+static double tick_price(long tick) { return tick * 0.01; }
+
+std::vector<Op> make_ops(size_t depth, size_t count, double deep_share, std::mt19937_64& rng) {
+    const long mid = 9000000;
+    std::exponential_distribution<double> near(1.0 / 20.0);
+    std::uniform_int_distribution<long> far(1, (long)depth);
+    std::uniform_real_distribution<double> u(0.0, 1.0);
+
+    std::vector<Op> ops;
+    ops.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        bool bid = u(rng) < 0.5;
+        long dist = u(rng) < deep_share ? far(rng) : 1 + (long)near(rng);
+        double qty = u(rng) < 0.3 ? 0.0 : 0.001 + u(rng);
+        ops.push_back({bid, tick_price(bid ? mid - dist : mid + dist), qty});
+    }
+    return ops;
+}
+
+// --- 2. TIMING ---
+template <class Book>
+double run(Book& book, const std::vector<Op>& ops) {
+    auto start = std::chrono::steady_clock::now();
+    for (const Op& op : ops) {
+        if (op.bid) book.update_bid(op.price, op.qty);
+        else book.update_ask(op.price, op.qty);
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / ops.size();
+}
+
+template <class Book>
+void seed(Book& book, size_t depth) {
+    // Worst-first so the vector book appends instead of shifting during setup
+    for (size_t d = depth; d >= 1; d--) {
+        book.update_bid(tick_price(9000000 - (long)d), 1.0);
+        book.update_ask(tick_price(9000000 + (long)d), 1.0);
+    }
+}
+
+// --- 3. MAIN ---
+int main(int argc, char** argv) {
+    size_t ops_per_run = 1'000'000;
+    double deep_share = 0.2; // share of updates spread uniformly over the whole book
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--ops") == 0 && i + 1 < argc) ops_per_run = std::atol(argv[++i]);
+        else if (std::strcmp(argv[i], "--deep-share") == 0 && i + 1 < argc) deep_share = std::atof(argv[++i]);
+    }
+
+    std::cout << "[BENCH] " << ops_per_run << " updates per run, " << deep_share * 100 << "% spread over the book" << std::endl;
+    std::cout << std::setw(8) << "levels" << std::setw(14) << "vector ns" << std::setw(14) << "hybrid ns"
+              << std::setw(10) << "speedup" << "  check" << std::endl;
+
+    for (size_t depth : {100, 1000, 5000, 10000, 20000, 50000}) {
+        std::mt19937_64 rng(42);
+        std::vector<Op> ops = make_ops(depth, ops_per_run, deep_share, rng);
+
+        std::pmr::unsynchronized_pool_resource pool;
+        OrderBook vec(&pool);
+        HybridOrderBook hybrid(&pool);
+        seed(vec, depth);
+        seed(hybrid, depth);
+
+        double vec_ns = run(vec, ops);
+        double hybrid_ns = run(hybrid, ops);
+        size_t levels = std::max(vec.bid_levels().size(), vec.ask_levels().size());
+        bool same = vec.checksum(levels) == hybrid.checksum(levels) &&
+                    vec.bid_levels().size() == hybrid.bid_depth() && vec.ask_levels().size() == hybrid.ask_depth();
+
+        std::cout << std::setw(8) << depth << std::fixed << std::setprecision(1)
+                  << std::setw(14) << vec_ns << std::setw(14) << hybrid_ns
+                  << std::setw(9) << vec_ns / hybrid_ns << "x  " << (same ? "match" : "MISMATCH") << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,120 @@
+#pragma once
+// Detects when our OrderBook stops matching the exchange: sequence gaps,
+// crossed/locked tops, and checksum mismatches against verified checkpoints.
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include "order_book.hpp"
+
+// Checksum the exchange's book had right after update `update_id`.
+struct Checkpoint {
+    long long update_id;
+    uint64_t checksum;
+};
+
+class BookValidator {
+public:
+    static constexpr size_t DEPTH = 10;    // levels per side covered by the checksum
+    static constexpr size_t HISTORY = 64;  // recent (update_id, checksum) pairs kept for late checkpoints
+
+    enum class Result { OK, STALE, VERIFIED, GAP, CROSSED, DIVERGED };
+
+    // Counters (read by the reporting code; written only by the book thread)
+    long long updates = 0;
+    long long stale = 0;
+    long long gaps = 0;
+    long long crossed = 0;
+    long long locked = 0;
+    long long verified = 0;
+    long long divergences = 0;
+    long long inconclusive = 0;
+    long long resyncs = 0;
+
+    // Call before applying a depth update covering [first_id, last_id]. Updates
+    // already contained in the current snapshot should be dropped.
+    bool should_apply(long long last_id) {
+        if (last_update_id != 0 && last_id <= last_update_id) { stale++; return false; }
+        return true;
+    }
+
+    // Call after applying the update. O(DEPTH) plus an O(HISTORY) scan only when
+    // a checkpoint is pending. Anything but OK/VERIFIED means the book needs a resync.
+    // Works with any book exposing checksum()/get_best_bid()/get_best_ask().
+    template <class Book>
+    Result on_update(const Book& book, long long first_id, long long last_id) {
+        updates++;
+        Result r = Result::OK;
+        if (last_update_id != 0 && first_id > last_update_id + 1) { gaps++; r = Result::GAP; }
+        last_update_id = last_id;
+
+        last_checksum = book.checksum(DEPTH);
+        history[history_pos++ % HISTORY] = {last_id, last_checksum};
+
+        double bid = book.get_best_bid(), ask = book.get_best_ask();
+        if (bid > 0 && ask > 0) {
+            if (ask < bid) { crossed++; r = Result::CROSSED; }
+            else if (ask == bid) locked++;
+        }
+
+        if (r == Result::OK && pending_ready.load(std::memory_order_acquire)) {
+            r = check_pending();
+        }
+        return r;
+    }
+
+    // Publishes an exchange checkpoint. Safe to call from one other thread; returns
+    // false if the previous checkpoint has not been consumed yet.
+    bool offer(const Checkpoint& c) {
+        if (pending_ready.load(std::memory_order_acquire)) return false;
+        pending = c;
+        pending_ready.store(true, std::memory_order_release);
+        return true;
+    }
+
+    // Call after the initial snapshot load.
+    void start(long long snapshot_update_id) {
+        last_update_id = snapshot_update_id;
+        history_pos = 0;
+        history.fill({0, 0});
+    }
+
+    // Call after reloading a snapshot to recover from an invalid book.
+    void on_resync(long long snapshot_update_id) {
+        resyncs++;
+        start(snapshot_update_id);
+    }
+
+    long long get_last_update_id() const { return last_update_id; }
+    uint64_t get_last_checksum() const { return last_checksum; }
+    const Checkpoint& get_last_verified() const { return last_verified; }
+
+private:
+    Result check_pending() {
+        Checkpoint c = pending;
+        if (c.update_id > last_update_id) return Result::OK; // not there yet, keep it
+
+        pending_ready.store(false, std::memory_order_release);
+        for (const Checkpoint& h : history) {
+            if (h.update_id != c.update_id) continue;
+            if (h.checksum == c.checksum) {
+                verified++;
+                last_verified = c;
+                return Result::VERIFIED;
+            }
+            divergences++;
+            return Result::DIVERGED;
+        }
+        // Checkpoint fell inside a multi-ID update or aged out of the history
+        inconclusive++;
+        return Result::OK;
+    }
+
+    long long last_update_id = 0;
+    uint64_t last_checksum = 0;
+    std::array<Checkpoint, HISTORY> history{};
+    size_t history_pos = 0;
+    Checkpoint last_verified{0, 0};
+
+    Checkpoint pending{0, 0};
+    std::atomic<bool> pending_ready{false};
+};
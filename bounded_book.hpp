@@ -0,0 +1,167 @@
+#pragma once
+// Top-of-book-only variant of OrderBook: each side keeps at most MaxDepth levels
+// in a fixed inline array (2 x 64 levels = 2 KB, 2 x 256 = 8 KB), so the whole
+// book stays in L1. Same interface as OrderBook, selected at compile time in the
+// live engine with -DHFT_BOOK_DEPTH=<MaxDepth>.
+//
+// Levels beyond the window are dropped. Each side remembers the worst price it
+// still knows completely (`boundary`); updates past it are ignored and counted in
+// out_of_window, because an unknown deeper level may sit in between. When deletes
+// drain a truncated side below LOW_WATER, needs_resync() asks for a fresh snapshot.
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <vector>
+#include "order_book.hpp"
+
+template <size_t MaxDepth>
+class BoundedOrderBook {
+    static_assert(MaxDepth >= 32, "window must cover the checksum depth and the strategy's top levels");
+
+public:
+    static constexpr size_t LOW_WATER = std::max<size_t>(MaxDepth / 4, 16);
+
+    long long out_of_window = 0; // updates ignored or levels dropped past the window
+
+    // The pool is unused; kept so the engine constructs either book the same way.
+    explicit BoundedOrderBook(std::pmr::memory_resource* = nullptr) {}
+
+    void update_bid(double price, double qty) { update<BidSide>(price, qty); }
+    void update_ask(double price, double qty) { update<AskSide>(price, qty); }
+
+    // Levels move inside a few cache lines, so per-level application is already cheap.
+    void apply_update(std::span<Level> bid_changes, std::span<Level> ask_changes) {
+        for (const Level& l : bid_changes) update_bid(l.price, l.quantity);
+        for (const Level& l : ask_changes) update_ask(l.price, l.quantity);
+    }
+
+    void load_snapshot(simdjson::dom::array& bid_array, simdjson::dom::array& ask_array, bool announce = true) {
+        if (announce) std::cout << "[SNAPSHOT] Loading top " << MaxDepth << " of " << bid_array.size() << " bids and "
+                                << ask_array.size() << " asks..." << std::endl;
+        std::vector<Level> levels;
+        parse_levels(bid_array, levels);
+        load_side<BidSide>(levels);
+        parse_levels(ask_array, levels);
+        load_side<AskSide>(levels);
+    }
+
+    double get_imbalance() const {
+        const Window& bids = sides[side_index(Side::BUY)];
+        const Window& asks = sides[side_index(Side::SELL)];
+        if (bids.n == 0 || asks.n == 0) return 0.5;
+        double bid_vol = 0, ask_vol = 0;
+        for (size_t i = 0; i < std::min((size_t)5, bids.n); i++) bid_vol += bids.levels[i].quantity;
+        for (size_t i = 0; i < std::min((size_t)5, asks.n); i++) ask_vol += asks.levels[i].quantity;
+        return bid_vol / (bid_vol + ask_vol);
+    }
+
+    double get_best(Side side) const {
+        const Window& w = sides[side_index(side)];
+        return w.n == 0 ? 0.0 : w.levels[0].price;
+    }
+    double get_best_bid() const { return get_best(Side::BUY); }
+    double get_best_ask() const { return get_best(Side::SELL); }
+
+    template <class Observer>
+    void apply_update(std::span<Level> bid_changes, std::span<Level> ask_changes, Observer& observer) {
+        apply_observed(*this, bid_changes, ask_changes, observer);
+    }
+
+    size_t top_levels(Side side, Level* out, size_t n) const {
+        auto l = levels_of(side);
+        n = std::min(n, l.size());
+        std::copy_n(l.begin(), n, out);
+        return n;
+    }
+
+    std::span<const Level> bid_levels() const { return levels_of(Side::BUY); }
+    std::span<const Level> ask_levels() const { return levels_of(Side::SELL); }
+
+    // True once a side that was cut off has drained too far to trust its depth.
+    bool needs_resync() const { return drained(sides[side_index(Side::BUY)]) || drained(sides[side_index(Side::SELL)]); }
+
+    using Sweep = OrderBook::Sweep;
+    Sweep sweep(Side order_side, double qty) const {
+        const Window& side = sides[side_index(opposite_side(order_side))];
+        Sweep s{0.0, 0.0};
+        for (size_t i = 0; i < side.n && s.filled < qty; i++) {
+            double take = std::min(qty - s.filled, side.levels[i].quantity);
+            s.filled += take;
+            s.notional += take * side.levels[i].price;
+        }
+        return s;
+    }
+
+    // Bit-identical to OrderBook::checksum while depth <= the levels held.
+    uint64_t checksum(size_t depth) const {
+        uint64_t h = 14695981039346656037ull;
+        auto mix = [&h](double v) { h = (h ^ std::bit_cast<uint64_t>(v)) * 1099511628211ull; };
+        const Window& bids = sides[side_index(Side::BUY)];
+        const Window& asks = sides[side_index(Side::SELL)];
+        for (size_t i = 0; i < std::min(depth, bids.n); i++) { mix(bids.levels[i].price); mix(bids.levels[i].quantity); }
+        mix(0.0);
+        for (size_t i = 0; i < std::min(depth, asks.n); i++) { mix(asks.levels[i].price); mix(asks.levels[i].quantity); }
+        return h;
+    }
+
+private:
+    struct Window {
+        std::array<Level, MaxDepth> levels;
+        size_t n = 0;
+        bool truncated = false; // levels exist past `boundary` that we do not hold
+        double boundary = 0.0;  // worst price known completely (valid when truncated)
+    };
+
+    static bool drained(const Window& w) { return w.truncated && w.n < LOW_WATER; }
+
+    std::span<const Level> levels_of(Side side) const {
+        const Window& w = sides[side_index(side)];
+        return {w.levels.data(), w.n};
+    }
+
+    template <class Tag>
+    void update(double price, double qty) {
+        Window& w = sides[side_index(Tag::side)];
+        if (w.truncated && Tag::before(w.boundary, price)) { out_of_window++; return; }
+
+        Level* begin = w.levels.data();
+        Level* end = begin + w.n;
+        Level* it = std::lower_bound(begin, end, price,
+            [](const Level& l, double val) { return Tag::before(l.price, val); });
+
+        if (it != end && it->price == price) {
+            if (qty <= 0.0000001) { std::copy(it + 1, end, it); w.n--; }
+            else it->quantity = qty;
+            return;
+        }
+        if (qty <= 0.0000001) return;
+
+        // Full: the worst level (or the new one) falls out and we only know up to the new worst
+        bool drop = w.n == MaxDepth;
+        if (drop) {
+            out_of_window++;
+            w.truncated = true;
+            if (it == end) { w.boundary = end[-1].price; return; }
+            end--;
+            w.n--;
+        }
+        std::copy_backward(it, end, end + 1);
+        *it = {price, qty};
+        w.n++;
+        if (drop) w.boundary = w.levels[MaxDepth - 1].price;
+    }
+
+    template <class Tag>
+    void load_side(std::vector<Level>& levels) {
+        Window& w = sides[side_index(Tag::side)];
+        std::sort(levels.begin(), levels.end(), [](const Level& a, const Level& b) { return Tag::before(a.price, b.price); });
+        w.n = std::min(levels.size(), MaxDepth);
+        std::copy(levels.begin(), levels.begin() + w.n, w.levels.begin());
+        w.truncated = levels.size() > MaxDepth;
+        w.boundary = w.n ? w.levels[w.n - 1].price : 0.0;
+    }
+
+    std::array<Window, 2> sides; // indexed by Side: bids, asks
+};
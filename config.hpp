@@ -0,0 +1,213 @@
+#pragma once
+// Engine configuration, read once at startup from a JSON file (--config) and
+// frozen for the rest of the run, except for the strategy/risk values the
+// engine's control channel can replace (control.hpp). Every key is optional: a missing key keeps
+// the built-in default, and an unknown key is an error, so a typo can't
+// silently fall back to a default. stream.path defaults to the symbol's depth
+// stream; a path naming another symbol's stream is rejected.
+//
+// {
+//   "symbol": "BTCUSD",
+//   "stream":   { "host": "stream.binance.us", "port": "9443", "path": "/ws/btcusd@depth" },
+//   "snapshot": { "host": "api.binance.us", "port": "443", "limit": 1000, "verify_interval_s": 30 },
+//   "risk":     { "max_order_value": 2000.0, "max_position": 0.01 },
+//   "strategy": { "buy_threshold": 0.8, "sell_threshold": 0.2, "trade_qty": 0.002,
+//                 "cooldown_after_fill": 2000, "cooldown_after_reject": 5000 },
+//   "backtest": { "cooldown": 100, "start_equity": 10000.0 },
+//   "arena_bytes": 1048576
+// }
+//
+// The values the hot path reads per message are kept together in HotConfig,
+// which fills exactly one cache line. Configuring with
+// -DHFT_CONFIG_PROFILE=<file.json> compiles that file's strategy/risk values
+// into the engine as constants (BAKED_HOT, generated by CMake) so they fold
+// into the strategy code. The file passed at runtime still supplies everything
+// else.
+#include <cctype>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <simdjson.h>
+
+#ifndef HFT_CONFIG_PROFILE
+#define HFT_CONFIG_PROFILE 0
+#endif
+
+struct alignas(64) HotConfig {
+    double max_order_value = 2000.0; // risk: notional per order, USD
+    double max_position = 0.01;      // risk: absolute net position, base units
+    double buy_threshold = 0.8;      // imbalance above which we buy
+    double sell_threshold = 0.2;     // imbalance below which we sell
+    double trade_qty = 0.002;
+    int cooldown_after_fill = 2000;  // updates to wait after sending an order
+    int cooldown_after_reject = 5000;// ... and after a risk reject
+
+    bool operator==(const HotConfig&) const = default;
+};
+static_assert(sizeof(HotConfig) == 64);
+
+struct EngineConfig {
+    HotConfig hot;
+
+    std::string symbol = "BTCUSD";
+    std::string stream_host = "stream.binance.us";
+    std::string stream_port = "9443";
+    std::string stream_path;      // empty: /ws/<symbol>@depth
+    std::string snapshot_host = "api.binance.us";
+    std::string snapshot_port = "443";
+    int snapshot_limit = 1000;
+    int verify_interval_s = 30;   // REST snapshot checks against the live book
+    int backtest_cooldown = 100;  // Backtester strategy cooldown, in updates
+    double start_equity = 10000.0;
+    size_t arena_bytes = 1024 * 1024; // book memory arena (order book levels)
+
+    std::string stream_target() const {
+        return stream_path.empty() ? "/ws/" + lower_symbol() + "@depth" : stream_path;
+    }
+
+    // Stream names use the lowercase symbol ("btcusd@depth")
+    std::string lower_symbol() const {
+        std::string s = symbol;
+        for (char& c : s) c = (char)std::tolower((unsigned char)c);
+        return s;
+    }
+
+    std::string snapshot_target() const {
+        return "/api/v3/depth?symbol=" + symbol + "&limit=" + std::to_string(snapshot_limit);
+    }
+};
+
+namespace config_detail {
+
+// Small typed readers: each names the dotted key it failed on in `error`
+inline bool read(simdjson::dom::element v, std::string& out, std::string_view key, std::string& error) {
+    std::string_view s;
+    if (v.get(s) != simdjson::SUCCESS) { error = std::string(key) + ": expected a string"; return false; }
+    out = s;
+    return true;
+}
+
+inline bool read(simdjson::dom::element v, double& out, std::string_view key, std::string& error) {
+    if (v.get(out) != simdjson::SUCCESS) { error = std::string(key) + ": expected a number"; return false; }
+    return true;
+}
+
+template <class Int>
+bool read_int(simdjson::dom::element v, Int& out, std::string_view key, int64_t min, std::string& error) {
+    int64_t n;
+    if (v.get(n) != simdjson::SUCCESS || n < min) {
+        error = std::string(key) + ": expected an integer >= " + std::to_string(min);
+        return false;
+    }
+    out = (Int)n;
+    return true;
+}
+
+inline bool unknown(std::string_view section, std::string_view key, std::string& error) {
+    error = "unknown key " + std::string(section) + (section.empty() ? "" : ".") + std::string(key);
+    return false;
+}
+
+} // namespace config_detail
+
+// Overwrites the fields of `cfg` named in `root`. On error `error` names the
+// offending key and `cfg` may be partially updated.
+inline bool apply_config(simdjson::dom::object root, EngineConfig& cfg, std::string& error) {
+    using namespace config_detail;
+    HotConfig& hot = cfg.hot;
+    for (auto [key, value] : root) {
+        bool ok = true;
+        if (key == "symbol") ok = read(value, cfg.symbol, key, error);
+        else if (key == "arena_bytes") ok = read_int(value, cfg.arena_bytes, key, 64 * 1024, error);
+        else if (key == "stream" || key == "snapshot" || key == "risk" || key == "strategy" || key == "backtest") {
+            simdjson::dom::object section;
+            if (value.get(section) != simdjson::SUCCESS) {
+                error = std::string(key) + ": expected an object";
+                return false;
+            }
+            for (auto [k, v] : section) {
+                std::string name = std::string(key) + "." + std::string(k);
+                if (key == "stream") {
+                    if (k == "host") ok = read(v, cfg.stream_host, name, error);
+                    else if (k == "port") ok = read(v, cfg.stream_port, name, error);
+                    else if (k == "path") ok = read(v, cfg.stream_path, name, error);
+                    else ok = unknown(key, k, error);
+                } else if (key == "snapshot") {
+                    if (k == "host") ok = read(v, cfg.snapshot_host, name, error);
+                    else if (k == "port") ok = read(v, cfg.snapshot_port, name, error);
+                    else if (k == "limit") ok = read_int(v, cfg.snapshot_limit, name, 1, error);
+                    else if (k == "verify_interval_s") ok = read_int(v, cfg.verify_interval_s, name, 1, error);
+                    else ok = unknown(key, k, error);
+                } else if (key == "risk") {
+                    if (k == "max_order_value") ok = read(v, hot.max_order_value, name, error);
+                    else if (k == "max_position") ok = read(v, hot.max_position, name, error);
+                    else ok = unknown(key, k, error);
+                } else if (key == "strategy") {
+                    if (k == "buy_threshold") ok = read(v, hot.buy_threshold, name, error);
+                    else if (k == "sell_threshold") ok = read(v, hot.sell_threshold, name, error);
+                    else if (k == "trade_qty") ok = read(v, hot.trade_qty, name, error);
+                    else if (k == "cooldown_after_fill") ok = read_int(v, hot.cooldown_after_fill, name, 0, error);
+                    else if (k == "cooldown_after_reject") ok = read_int(v, hot.cooldown_after_reject, name, 0, error);
+                    else ok = unknown(key, k, error);
+                } else {
+                    if (k == "cooldown") ok = read_int(v, cfg.backtest_cooldown, name, 0, error);
+                    else if (k == "start_equity") ok = read(v, cfg.start_equity, name, error);
+                    else ok = unknown(key, k, error);
+                }
+                if (!ok) return false;
+            }
+        } else ok = unknown("", key, error);
+        if (!ok) return false;
+    }
+    return true;
+}
+
+// Snapshots and orders use `symbol`; the stream must carry the same market.
+inline bool validate_stream(const EngineConfig& cfg, std::string& error) {
+    if (cfg.stream_path.empty() || cfg.stream_path.find("/" + cfg.lower_symbol() + "@") != std::string::npos) return true;
+    error = "stream.path " + cfg.stream_path + " is not a stream of symbol " + cfg.symbol;
+    return false;
+}
+
+// nullptr if `hot` is usable. constexpr so a compiled-in profile is checked at build time.
+constexpr const char* hot_config_error(const HotConfig& hot) {
+    if (!(hot.sell_threshold < hot.buy_threshold) || hot.sell_threshold < 0.0 || hot.buy_threshold > 1.0)
+        return "strategy: need 0 <= sell_threshold < buy_threshold <= 1";
+    if (!(hot.trade_qty > 0.0) || !(hot.max_order_value > 0.0) || !(hot.max_position > 0.0))
+        return "trade_qty, max_order_value and max_position must be positive";
+    if (hot.cooldown_after_fill < 0 || hot.cooldown_after_reject < 0)
+        return "strategy: cooldowns must be >= 0";
+    return nullptr;
+}
+
+inline bool validate(const HotConfig& hot, std::string& error) {
+    if (const char* e = hot_config_error(hot)) {
+        error = e;
+        return false;
+    }
+    return true;
+}
+
+// Fills `cfg` from a JSON file. Prints the offending key and returns false on
+// any error; `cfg` should then not be used.
+inline bool load_config(const std::string& path, EngineConfig& cfg) {
+    simdjson::dom::parser parser;
+    simdjson::dom::object root;
+    if (auto err = parser.load(path).get(root)) {
+        std::cerr << "[CONFIG] Cannot read " << path << ": " << simdjson::error_message(err) << std::endl;
+        return false;
+    }
+    std::string error;
+    if (!apply_config(root, cfg, error) || !validate(cfg.hot, error) || !validate_stream(cfg, error)) {
+        std::cerr << "[CONFIG] " << path << ": " << error << std::endl;
+        return false;
+    }
+    return true;
+}
+
+#if HFT_CONFIG_PROFILE
+#include "hft_profile.hpp" // constexpr HotConfig BAKED_HOT
+static_assert(hot_config_error(BAKED_HOT) == nullptr,
+              "HFT_CONFIG_PROFILE: invalid strategy/risk values (see hot_config_error in config.hpp)");
+#endif
@@ -0,0 +1,220 @@
+#pragma once
+// Operator control channel: replaces the strategy/risk parameters (HotConfig)
+// of a running engine without a restart, so the synced book survives.
+//
+// An operator connects to a Unix socket and sends one JSON object per line,
+// using the "risk" and "strategy" sections of the config file format:
+//
+//   echo '{"strategy":{"buy_threshold":0.75}}' | socat - UNIX-CONNECT:/tmp/hft.ctl
+//
+// The control thread applies the change to a copy of the live parameters and
+// validates it. It then publishes the copy by pointer swap and replies with the
+// full parameter set, or with an error and nothing changed. The hot thread
+// picks the new set up on its next message without taking a lock. An empty
+// line just returns the current set.
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <stop_token>
+#include <string>
+#include <vector>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <simdjson.h>
+#include "config.hpp"
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0 // macOS: SO_NOSIGPIPE is set on the client socket instead
+#endif
+
+// --- 1. PARAMETER CELL ---
+// RCU with epoch-based reclamation, specialised to one reader (the hot thread).
+// A publish swaps the pointer and bumps the epoch. The reader notices the bump
+// on its next read(), switches pointers and acknowledges the epoch. That
+// acknowledgement is its quiescent state: sets retired at or before the
+// acknowledged epoch can no longer be referenced and are freed by the writer.
+// In steady state read() is one load of a line that only a publish writes.
+class LiveConfig {
+public:
+    explicit LiveConfig(const HotConfig& initial) : current(new HotConfig(initial)), cached(current.load()) {}
+
+    ~LiveConfig() {
+        delete current.load();
+        for (const Retired& r : retired) delete r.params;
+    }
+
+    LiveConfig(const LiveConfig&) = delete;
+    LiveConfig& operator=(const LiveConfig&) = delete;
+
+    // Hot thread only. The reference stays valid until the next read().
+    const HotConfig& read() {
+        uint64_t e = epoch.load(std::memory_order_acquire);
+        if (e != seen) [[unlikely]] {
+            cached = current.load(std::memory_order_acquire);
+            seen = e;
+            reader_epoch.store(e, std::memory_order_release);
+        }
+        return *cached;
+    }
+
+    // Copy of the newest published set (control side)
+    HotConfig latest() {
+        std::lock_guard lock(mtx);
+        return *current.load(std::memory_order_acquire);
+    }
+
+    // Returns the epoch `next` was published at
+    uint64_t publish(const HotConfig& next) {
+        std::lock_guard lock(mtx);
+        HotConfig* old = current.exchange(new HotConfig(next), std::memory_order_acq_rel);
+        uint64_t e = epoch.fetch_add(1, std::memory_order_acq_rel) + 1;
+        retired.push_back({old, e});
+        reclaim_locked();
+        return e;
+    }
+
+    // Frees retired sets the reader has moved past; called periodically by the control thread
+    void reclaim() {
+        std::lock_guard lock(mtx);
+        reclaim_locked();
+    }
+
+private:
+    struct Retired { HotConfig* params; uint64_t epoch; };
+
+    void reclaim_locked() {
+        uint64_t safe = reader_epoch.load(std::memory_order_acquire);
+        std::erase_if(retired, [&](const Retired& r) {
+            if (r.epoch > safe) return false;
+            delete r.params;
+            return true;
+        });
+    }
+
+    // Written by publish() only
+    alignas(64) std::atomic<HotConfig*> current;
+    std::atomic<uint64_t> epoch{0};
+    // Written by the reader only
+    alignas(64) std::atomic<uint64_t> reader_epoch{0};
+    // Reader-private
+    alignas(64) const HotConfig* cached;
+    uint64_t seen = 0;
+
+    std::mutex mtx; // writers and reclamation
+    std::vector<Retired> retired;
+};
+
+// --- 2. CONTROL SOCKET ---
+// Unix stream socket (mode 0600) served by its own thread. One JSON object per
+// line; each line gets one reply line starting with "OK" or "ERROR".
+class ControlChannel {
+public:
+    ~ControlChannel() {
+        if (fd >= 0) {
+            ::close(fd);
+            ::unlink(path.c_str());
+        }
+    }
+
+    bool open(const std::string& socket_path) {
+        sockaddr_un addr{};
+        if (socket_path.size() >= sizeof(addr.sun_path)) return false;
+        addr.sun_family = AF_UNIX;
+        std::memcpy(addr.sun_path, socket_path.c_str(), socket_path.size() + 1);
+        fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) return false;
+        // A stale socket from a previous run is replaced; anything else at the path is left alone
+        struct stat st;
+        if (::lstat(socket_path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) ::unlink(socket_path.c_str());
+        if (::bind(fd, (sockaddr*)&addr, sizeof(addr)) < 0 || ::chmod(socket_path.c_str(), 0600) < 0 || ::listen(fd, 4) < 0) {
+            ::close(fd);
+            fd = -1;
+            return false;
+        }
+        path = socket_path;
+        return true;
+    }
+
+    void run(std::stop_token stop, LiveConfig& live) {
+        while (!stop.stop_requested()) {
+            pollfd p{fd, POLLIN, 0};
+            if (::poll(&p, 1, 200) <= 0) {
+                live.reclaim();
+                continue;
+            }
+            int client = ::accept(fd, nullptr, nullptr);
+            if (client < 0) continue;
+#if defined(SO_NOSIGPIPE)
+            int one = 1;
+            ::setsockopt(client, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+            timeval timeout{1, 0}; // a silent client can't wedge the channel
+            ::setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+            serve(client, live);
+            ::close(client);
+        }
+    }
+
+private:
+    void serve(int client, LiveConfig& live) {
+        std::string pending;
+        char buf[4096];
+        for (ssize_t n; (n = ::recv(client, buf, sizeof(buf), 0)) > 0;) {
+            pending.append(buf, (size_t)n);
+            for (size_t eol; (eol = pending.find('\n')) != std::string::npos;) {
+                std::string reply = handle(std::string_view(pending).substr(0, eol), live) + "\n";
+                ::send(client, reply.data(), reply.size(), MSG_NOSIGNAL);
+                pending.erase(0, eol + 1);
+            }
+        }
+        if (pending.find_first_not_of(" \t\r") != std::string::npos) {
+            std::string reply = handle(pending, live) + "\n";
+            ::send(client, reply.data(), reply.size(), MSG_NOSIGNAL);
+        }
+    }
+
+    // Validation happens here, off the hot thread; only a valid set is published
+    std::string handle(std::string_view line, LiveConfig& live) {
+        if (line.find_first_not_of(" \t\r") == std::string_view::npos) return "OK " + to_json(live.latest());
+        simdjson::dom::object root;
+        if (auto err = parser.parse(line.data(), line.size()).get(root)) {
+            return std::string("ERROR ") + simdjson::error_message(err);
+        }
+        for (auto [key, value] : root) {
+            if (key != "risk" && key != "strategy") {
+                return "ERROR " + std::string(key) + " is not reloadable (restart required)";
+            }
+        }
+        EngineConfig scratch;
+        scratch.hot = live.latest();
+        std::string error;
+        if (!apply_config(root, scratch, error) || !validate(scratch.hot, error)) {
+            return "ERROR " + error;
+        }
+        uint64_t e = live.publish(scratch.hot);
+        std::string params = to_json(scratch.hot);
+        std::cout << "[CONTROL] Parameters updated (epoch " << e << "): " << params << std::endl;
+        return "OK " + params;
+    }
+
+    static std::string to_json(const HotConfig& h) {
+        char out[320];
+        snprintf(out, sizeof(out),
+            "{\"risk\":{\"max_order_value\":%.10g,\"max_position\":%.10g},"
+            "\"strategy\":{\"buy_threshold\":%.10g,\"sell_threshold\":%.10g,\"trade_qty\":%.10g,"
+            "\"cooldown_after_fill\":%d,\"cooldown_after_reject\":%d}}",
+            h.max_order_value, h.max_position, h.buy_threshold, h.sell_threshold, h.trade_qty,
+            h.cooldown_after_fill, h.cooldown_after_reject);
+        return out;
+    }
+
+    int fd = -1;
+    std::string path;
+    simdjson::dom::parser parser;
+};
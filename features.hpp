@@ -0,0 +1,143 @@
+#pragma once
+// Per-update book features for offline signal research, written in a simple
+// columnar layout ("HFTC") that numpy/pandas can read without a dependency:
+//
+//   FileHeader | names[n_columns] (32-byte, NUL-padded)
+//   then per row group: uint32 rows | uint32 reserved | column 0[rows] | column 1[rows] | ...
+//
+// Every column is 8 bytes wide (int64 for *_ns/*_id columns, float64 otherwise),
+// so a group is one contiguous block per column and is written with one write()
+// per column.
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "order_book.hpp"
+
+// --- COLUMNAR WRITER ---
+class ColumnarWriter {
+public:
+    static constexpr uint32_t MAGIC = 0x43544648;  // "HFTC"
+    static constexpr size_t NAME_LEN = 32;
+    static constexpr size_t GROUP_ROWS = 65536;
+
+    struct FileHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t n_columns;
+        uint32_t group_rows;
+    };
+
+    bool open(const std::string& path, const std::vector<std::string>& names) {
+        out.open(path, std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) return false;
+        FileHeader h{MAGIC, 1, (uint32_t)names.size(), (uint32_t)GROUP_ROWS};
+        out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+        for (const auto& n : names) {
+            char buf[NAME_LEN] = {};
+            std::memcpy(buf, n.data(), std::min(n.size(), NAME_LEN - 1));
+            out.write(buf, NAME_LEN);
+        }
+        columns.assign(names.size(), std::vector<uint64_t>(GROUP_ROWS));
+        return true;
+    }
+
+    // Column `c` of the row being built; bit-copied so int64 and float64 share storage.
+    void set(size_t c, double v) { std::memcpy(&columns[c][rows], &v, sizeof(v)); }
+    void set(size_t c, int64_t v) { std::memcpy(&columns[c][rows], &v, sizeof(v)); }
+
+    void end_row() {
+        if (++rows == GROUP_ROWS) flush();
+        total++;
+    }
+
+    void close() {
+        flush();
+        out.close();
+    }
+
+    size_t row_count() const { return total; }
+
+private:
+    void flush() {
+        if (rows == 0) return;
+        uint32_t group[2] = {(uint32_t)rows, 0};
+        out.write(reinterpret_cast<const char*>(group), sizeof(group));
+        for (const auto& col : columns) out.write(reinterpret_cast<const char*>(col.data()), rows * sizeof(uint64_t));
+        rows = 0;
+    }
+
+    std::ofstream out;
+    std::vector<std::vector<uint64_t>> columns;
+    size_t rows = 0;
+    size_t total = 0;
+};
+
+// --- FEATURE EXTRACTOR ---
+// Depth and imbalance at several horizons, plus order flow imbalance (OFI) at
+// the touch. The depth stream carries no trades, so OFI - the signed change in
+// resting quantity at the best levels - stands in for trade flow.
+class FeatureExtractor {
+public:
+    static constexpr std::array<size_t, 4> DEPTHS = {1, 5, 10, 20};
+
+    static std::vector<std::string> column_names() {
+        std::vector<std::string> n = {"event_ns", "update_id", "mid", "spread", "microprice", "ofi", "levels_changed"};
+        for (size_t d : DEPTHS) n.push_back("bid_depth_" + std::to_string(d));
+        for (size_t d : DEPTHS) n.push_back("ask_depth_" + std::to_string(d));
+        for (size_t d : DEPTHS) n.push_back("imbalance_" + std::to_string(d));
+        return n;
+    }
+
+    // Emits one row for the book state after an update. Returns false for
+    // one-sided or crossed books, which are skipped.
+    bool extract(const OrderBook& book, int64_t event_ns, int64_t update_id, int64_t levels_changed, ColumnarWriter& w) {
+        const auto& bids = book.bid_levels();
+        const auto& asks = book.ask_levels();
+        if (bids.empty() || asks.empty() || asks[0].price <= bids[0].price) return false;
+
+        const Level& b = bids[0];
+        const Level& a = asks[0];
+        double ofi = 0.0;
+        if (prev_bid.price > 0) {
+            ofi += (b.price >= prev_bid.price ? b.quantity : 0.0) - (b.price <= prev_bid.price ? prev_bid.quantity : 0.0);
+            ofi -= (a.price <= prev_ask.price ? a.quantity : 0.0) - (a.price >= prev_ask.price ? prev_ask.quantity : 0.0);
+        }
+        prev_bid = b;
+        prev_ask = a;
+
+        size_t c = 0;
+        w.set(c++, event_ns);
+        w.set(c++, update_id);
+        w.set(c++, (a.price + b.price) / 2.0);
+        w.set(c++, a.price - b.price);
+        w.set(c++, (b.price * a.quantity + a.price * b.quantity) / (a.quantity + b.quantity));
+        w.set(c++, ofi);
+        w.set(c++, (double)levels_changed);
+
+        std::array<double, DEPTHS.size()> bid_depth{}, ask_depth{};
+        cumulative(bids, bid_depth);
+        cumulative(asks, ask_depth);
+        for (double v : bid_depth) w.set(c++, v);
+        for (double v : ask_depth) w.set(c++, v);
+        for (size_t i = 0; i < DEPTHS.size(); i++) w.set(c++, bid_depth[i] / (bid_depth[i] + ask_depth[i]));
+        w.end_row();
+        return true;
+    }
+
+private:
+    template <class Levels>
+    static void cumulative(const Levels& levels, std::array<double, DEPTHS.size()>& out) {
+        double sum = 0.0;
+        size_t d = 0;
+        for (size_t i = 0; i < DEPTHS.back() && d < DEPTHS.size(); i++) {
+            if (i < levels.size()) sum += levels[i].quantity;
+            if (i + 1 == DEPTHS[d]) out[d++] = sum;
+        }
+    }
+
+    Level prev_bid{0.0, 0.0};
+    Level prev_ask{0.0, 0.0};
+};
@@ -0,0 +1,470 @@
+#pragma once
+// Large-block file I/O for the block recorder and the replay prefetcher.
+//
+// Both classes move data in big sector-aligned chunks through a small io_uring
+// ring. They open with O_DIRECT where the filesystem allows it, so recordings
+// do not churn the page cache and there is no extra copy through the kernel.
+// The ring is driven by raw syscalls (no liburing dependency), and its staging
+// buffers are registered once so the kernel does not remap them on every
+// request. Where io_uring is unavailable (old kernel, seccomp, non-Linux) the
+// same code falls back to pwrite/pread.
+//
+//   DirectAppender  append-only writer; double-buffered staging, one write per
+//                   full stage, partial tail sector padded on flush() and
+//                   truncated on close.
+//   ReadaheadFile   random-access reader with a window of chunks read ahead of
+//                   the current position.
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#undef BLOCK_SIZE // from <linux/fs.h>; recording.hpp uses the name
+#endif
+
+constexpr size_t IO_ALIGN = 4096; // covers the logical sector size of every disk we record to
+
+inline size_t align_down(size_t v) { return v & ~(IO_ALIGN - 1); }
+inline size_t align_up(size_t v) { return align_down(v + IO_ALIGN - 1); }
+
+// Opens with O_DIRECT when the filesystem supports it (tmpfs does not).
+inline int open_direct(const std::string& path, int flags, bool& direct) {
+#ifdef O_DIRECT
+    int fd = ::open(path.c_str(), flags | O_DIRECT, 0644);
+    direct = fd >= 0;
+    if (fd >= 0) return fd;
+#endif
+    direct = false;
+    return ::open(path.c_str(), flags, 0644);
+}
+
+// --- 1. RING ---
+#if defined(__linux__)
+class IoRing {
+public:
+    ~IoRing() {
+        if (sq_ptr) munmap(sq_ptr, sq_len);
+        if (cq_ptr && cq_ptr != sq_ptr) munmap(cq_ptr, cq_len);
+        if (sqes) munmap(sqes, sqes_len);
+        if (fd >= 0) ::close(fd);
+    }
+
+    // False when io_uring is unavailable; the caller then uses plain syscalls.
+    bool init(unsigned entries) {
+        io_uring_params p{};
+        fd = (int)syscall(__NR_io_uring_setup, entries, &p);
+        if (fd < 0) return false;
+
+        sq_len = p.sq_off.array + p.sq_entries * sizeof(uint32_t);
+        cq_len = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+        if (p.features & IORING_FEAT_SINGLE_MMAP) sq_len = cq_len = std::max(sq_len, cq_len);
+        sq_ptr = map(sq_len, IORING_OFF_SQ_RING);
+        cq_ptr = (p.features & IORING_FEAT_SINGLE_MMAP) ? sq_ptr : map(cq_len, IORING_OFF_CQ_RING);
+        sqes_len = p.sq_entries * sizeof(io_uring_sqe);
+        sqes = static_cast<io_uring_sqe*>(map(sqes_len, IORING_OFF_SQES));
+        if (!sq_ptr || !cq_ptr || !sqes) return false;
+
+        auto* sq = static_cast<uint8_t*>(sq_ptr);
+        auto* cq = static_cast<uint8_t*>(cq_ptr);
+        sq_tail = reinterpret_cast<unsigned*>(sq + p.sq_off.tail);
+        sq_mask = *reinterpret_cast<unsigned*>(sq + p.sq_off.ring_mask);
+        sq_array = reinterpret_cast<unsigned*>(sq + p.sq_off.array);
+        cq_head = reinterpret_cast<unsigned*>(cq + p.cq_off.head);
+        cq_tail = reinterpret_cast<unsigned*>(cq + p.cq_off.tail);
+        cq_mask = *reinterpret_cast<unsigned*>(cq + p.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe*>(cq + p.cq_off.cqes);
+        return true;
+    }
+
+    // Registered buffers are pinned once; *_FIXED ops then skip the per-request page walk.
+    bool register_buffers(const iovec* iov, unsigned n) {
+        return syscall(__NR_io_uring_register, fd, IORING_REGISTER_BUFFERS, iov, n) == 0;
+    }
+
+    // Queues a fixed-buffer read or write of `len` bytes at `offset`; submitted by the next wait().
+    void queue(uint8_t op, int file, void* buf, unsigned len, uint64_t offset, uint16_t buf_index, uint64_t tag) {
+        unsigned tail = *sq_tail;
+        unsigned idx = tail & sq_mask;
+        io_uring_sqe& sqe = sqes[idx];
+        std::memset(&sqe, 0, sizeof(sqe));
+        sqe.opcode = op;
+        sqe.fd = file;
+        sqe.addr = reinterpret_cast<uint64_t>(buf);
+        sqe.len = len;
+        sqe.off = offset;
+        sqe.buf_index = buf_index;
+        sqe.user_data = tag;
+        sq_array[idx] = idx;
+        __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+        pending++;
+    }
+
+    // Submits everything queued and blocks until `min_complete` completions are ready.
+    void wait(unsigned min_complete) {
+        unsigned submit = pending;
+        pending = 0;
+        while (syscall(__NR_io_uring_enter, fd, submit, min_complete, IORING_ENTER_GETEVENTS, nullptr, 0) < 0 && errno == EINTR) {
+            submit = 0;
+        }
+    }
+
+    // Pops one completion if available: its tag and result (bytes or -errno).
+    bool reap(uint64_t& tag, int& res) {
+        unsigned head = *cq_head;
+        if (head == __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE)) return false;
+        const io_uring_cqe& cqe = cqes[head & cq_mask];
+        tag = cqe.user_data;
+        res = cqe.res;
+        __atomic_store_n(cq_head, head + 1, __ATOMIC_RELEASE);
+        return true;
+    }
+
+private:
+    void* map(size_t len, off_t what) {
+        void* p = mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, what);
+        return p == MAP_FAILED ? nullptr : p;
+    }
+
+    int fd = -1;
+    void* sq_ptr = nullptr;
+    void* cq_ptr = nullptr;
+    io_uring_sqe* sqes = nullptr;
+    size_t sq_len = 0, cq_len = 0, sqes_len = 0;
+    unsigned* sq_tail = nullptr;
+    unsigned* sq_array = nullptr;
+    unsigned sq_mask = 0;
+    unsigned* cq_head = nullptr;
+    unsigned* cq_tail = nullptr;
+    unsigned cq_mask = 0;
+    io_uring_cqe* cqes = nullptr;
+    unsigned pending = 0;
+};
+#endif
+
+// --- 2. WRITER ---
+// Appends to a file in STAGE-sized aligned writes. While one stage is being
+// written the caller fills the other. durable_offset() is the logical size
+// known to be on disk, so callers can hold back index entries until the bytes
+// they point at have landed.
+class DirectAppender {
+public:
+    static constexpr size_t STAGE = 1 << 20;
+
+    long long errors = 0;
+
+    ~DirectAppender() { close(); }
+
+    bool open(const std::string& path, bool use_uring = true) {
+        fd = open_direct(path, O_RDWR | O_CREAT, direct);
+        if (fd < 0) return false;
+        for (auto& s : stages) s = static_cast<char*>(std::aligned_alloc(IO_ALIGN, STAGE));
+
+        // Appending: restart from the last aligned sector, carrying its live bytes in the stage
+        struct stat st;
+        fstat(fd, &st);
+        logical = durable = (uint64_t)st.st_size;
+        stage_off = align_down(logical);
+        fill = logical - stage_off;
+        if (fill > 0 && ::pread(fd, stages[cur], IO_ALIGN, (off_t)stage_off) < (ssize_t)fill) return false;
+
+#if defined(__linux__)
+        if (use_uring && ring.init(8)) {
+            iovec iov[2] = {{stages[0], STAGE}, {stages[1], STAGE}};
+            uring = true;
+            fixed = ring.register_buffers(iov, 2);
+        }
+#endif
+        return true;
+    }
+
+    bool is_open() const { return fd >= 0; }
+    bool using_uring() const { return uring; }
+    bool using_direct() const { return direct; }
+    uint64_t size() const { return logical; }
+    uint64_t durable_offset() const { return durable; }
+
+    void append(const char* data, size_t len) {
+        while (len > 0) {
+            size_t n = std::min(len, STAGE - fill);
+            std::memcpy(stages[cur] + fill, data, n);
+            fill += n;
+            logical += n;
+            data += n;
+            len -= n;
+            if (fill == STAGE) {
+                size_t from = align_down(flushed);
+                write_stage(cur, from, STAGE - from, stage_off + from, false);
+                stage_off += STAGE;
+                fill = flushed = 0;
+                cur ^= 1;
+                wait_stage(cur); // the stage we switch to may still be in flight
+            }
+        }
+    }
+
+    // Makes everything appended so far durable (short of a power loss): writes the
+    // staged tail padded to a sector and waits for it. Later appends overwrite the
+    // padding, so a crash can leave zeros after the last complete record.
+    void flush() {
+        if (fd < 0) return;
+        wait_stage(cur ^ 1);
+        write_tail();
+    }
+
+    // Writes the partial last stage (padded to a sector) and trims the file to its logical size.
+    void close() {
+        if (fd < 0) return;
+        wait_stage(cur ^ 1);
+        write_tail();
+        if (fill > 0 && ftruncate(fd, (off_t)logical) != 0) errors++;
+        ::close(fd);
+        fd = -1;
+        for (auto& s : stages) std::free(s);
+        stages = {};
+    }
+
+private:
+    // Synchronously writes the sectors of the current stage not yet on disk.
+    void write_tail() {
+        if (fill == flushed) return;
+        size_t from = align_down(flushed);
+        size_t len = align_up(fill);
+        std::memset(stages[cur] + fill, 0, len - fill);
+        write_stage(cur, from, len - from, stage_off + from, true);
+        flushed = fill;
+    }
+
+    // Writes stages[s][from, from + len) at `off`. After a failed write `durable`
+    // stops advancing, so it never covers a hole.
+    void write_stage(int s, size_t from, size_t len, uint64_t off, bool sync) {
+#if defined(__linux__)
+        if (uring) {
+            writes[s] = {from, len, off, std::min<uint64_t>(off + len, logical)};
+            in_flight[s] = true;
+            submit(s);
+            if (sync) wait_stage(s);
+            return;
+        }
+#endif
+        for (size_t done = 0; done < len;) {
+            ssize_t r = ::pwrite(fd, stages[s] + from + done, len - done, (off_t)(off + done));
+            if (r < 0 && errno == EINTR) continue;
+            if (r <= 0) { errors++; return; }
+            done += r;
+        }
+        if (!errors) durable = std::min<uint64_t>(off + len, logical);
+    }
+
+#if defined(__linux__)
+    void submit(int s) {
+        const Write& w = writes[s];
+        ring.queue(fixed ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE, fd, stages[s] + w.from, (unsigned)w.len, w.off, (uint16_t)s, s);
+        ring.wait(0);
+    }
+#endif
+
+    // Reaps completions until stage `s` is written. A short write is resubmitted
+    // for the remainder, like the pwrite loop. `durable` only moves past a write
+    // once the older one (the other stage) is done too, so completions that
+    // arrive out of order never let it cover a write that may still fail.
+    void wait_stage(int s) {
+#if defined(__linux__)
+        while (in_flight[s]) {
+            uint64_t tag;
+            int res;
+            if (!ring.reap(tag, res)) { ring.wait(1); continue; }
+            Write& w = writes[tag];
+            if (res > 0 && (size_t)res < w.len) {
+                w.from += res;
+                w.off += res;
+                w.len -= res;
+                submit((int)tag);
+                continue;
+            }
+            in_flight[tag] = false;
+            if (res <= 0) errors++;
+            else done_end[tag] = w.end;
+            for (int t = 0; t < 2; t++) {
+                if (!done_end[t] || (in_flight[t ^ 1] && writes[t ^ 1].off < writes[t].off)) continue;
+                if (!errors) durable = std::max(durable, done_end[t]);
+                done_end[t] = 0;
+            }
+        }
+#else
+        (void)s;
+#endif
+    }
+
+    int fd = -1;
+    bool direct = false;
+    bool uring = false;
+    bool fixed = false;
+    std::array<char*, 2> stages{};
+    int cur = 0;
+    size_t fill = 0;          // bytes in stages[cur]
+    size_t flushed = 0;       // of those, already written by flush()
+    uint64_t stage_off = 0;   // file offset of stages[cur] (sector-aligned)
+    uint64_t logical = 0;     // file size including staged bytes
+    uint64_t durable = 0;
+    struct Write {
+        size_t from;   // in the stage
+        size_t len;    // still to write
+        uint64_t off;  // file offset of stages[s] + from
+        uint64_t end;  // durable once written: min(end of the write, logical size then)
+    };
+    std::array<bool, 2> in_flight{};
+    std::array<Write, 2> writes{};
+    std::array<uint64_t, 2> done_end{}; // written, waiting for the older write before counting as durable
+#if defined(__linux__)
+    IoRing ring;
+#endif
+};
+
+// --- 3. READER ---
+// Serves read(offset, len) from CHUNK-sized aligned chunks. After each read the
+// next DEPTH chunks are in flight, so a sequential scan never waits on the disk
+// as long as decoding is slower than reading. A seek discards the window.
+class ReadaheadFile {
+public:
+    static constexpr size_t CHUNK = 1 << 20;
+    static constexpr unsigned DEPTH = 4;
+
+    long long errors = 0;
+
+    ~ReadaheadFile() { close(); }
+
+    bool open(const std::string& path, bool use_uring = true) {
+        fd = open_direct(path, O_RDONLY, direct);
+        if (fd < 0) return false;
+        struct stat st;
+        fstat(fd, &st);
+        file_size = (uint64_t)st.st_size;
+        for (auto& s : slots) s.data = static_cast<char*>(std::aligned_alloc(IO_ALIGN, CHUNK));
+#if defined(__linux__)
+        if (use_uring && ring.init(DEPTH * 2)) {
+            std::array<iovec, DEPTH> iov;
+            for (unsigned i = 0; i < DEPTH; i++) iov[i] = {slots[i].data, CHUNK};
+            uring = true;
+            fixed = ring.register_buffers(iov.data(), DEPTH);
+        }
+#endif
+        if (!uring) posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+        return true;
+    }
+
+    void close() {
+        if (fd < 0) return;
+        for (unsigned i = 0; i < DEPTH; i++) settle(i);
+        ::close(fd);
+        fd = -1;
+        for (auto& s : slots) std::free(s.data);
+        slots = {};
+    }
+
+    bool is_open() const { return fd >= 0; }
+    bool using_uring() const { return uring; }
+    uint64_t size() const { return file_size; }
+
+    // Copies [offset, offset + len) into `dst`; false if it runs past the end of the file.
+    bool read(uint64_t offset, char* dst, size_t len) {
+        if (offset + len > file_size) return false;
+        while (len > 0) {
+            uint64_t chunk = offset / CHUNK;
+            Slot* s = load(chunk);
+            if (!s) return false;
+            size_t in_chunk = offset - chunk * CHUNK;
+            size_t n = std::min(len, s->valid - std::min(s->valid, in_chunk));
+            if (n == 0) return false;
+            std::memcpy(dst, s->data + in_chunk, n);
+            dst += n;
+            offset += n;
+            len -= n;
+        }
+        return true;
+    }
+
+private:
+    struct Slot {
+        char* data = nullptr;
+        uint64_t chunk = UINT64_MAX;
+        size_t valid = 0;
+        bool in_flight = false;
+    };
+
+    Slot* load(uint64_t chunk) {
+        Slot& s = slots[chunk % DEPTH];
+        if (s.chunk != chunk) {
+            settle(chunk % DEPTH);
+            fetch(chunk, true);
+        }
+        settle(chunk % DEPTH);
+        // Keep the next DEPTH - 1 chunks in flight behind the one being consumed
+        for (uint64_t c = chunk + 1; c < chunk + DEPTH && c * CHUNK < file_size; c++) {
+            Slot& ahead = slots[c % DEPTH];
+            if (ahead.chunk != c) { settle(c % DEPTH); fetch(c, false); }
+        }
+        return s.valid > 0 ? &s : nullptr;
+    }
+
+    void fetch(uint64_t chunk, bool needed_now) {
+        Slot& s = slots[chunk % DEPTH];
+        s.chunk = chunk;
+        s.valid = 0;
+        uint64_t off = chunk * CHUNK;
+        size_t len = (size_t)std::min<uint64_t>(CHUNK, align_up(file_size - off));
+#if defined(__linux__)
+        if (uring) {
+            ring.queue(fixed ? IORING_OP_READ_FIXED : IORING_OP_READ, fd, s.data, (unsigned)len, off, (uint16_t)(chunk % DEPTH), chunk % DEPTH);
+            s.in_flight = true;
+            if (!needed_now) ring.wait(0);
+            return;
+        }
+#endif
+        (void)needed_now;
+        for (size_t done = 0; done < len;) {
+            ssize_t r = ::pread(fd, s.data + done, len - done, (off_t)(off + done));
+            if (r < 0 && errno == EINTR) continue;
+            if (r < 0) errors++;
+            if (r <= 0) break;
+            done += r;
+        }
+        s.valid = std::min<uint64_t>(len, file_size - off);
+    }
+
+    // Waits for the slot's read, if one is in flight, and records how much of it is valid.
+    void settle(unsigned i) {
+#if defined(__linux__)
+        while (slots[i].in_flight) {
+            uint64_t tag;
+            int res;
+            if (!ring.reap(tag, res)) { ring.wait(1); continue; }
+            Slot& done = slots[tag];
+            done.in_flight = false;
+            if (res < 0) { errors++; done.valid = 0; }
+            else done.valid = std::min<uint64_t>((uint64_t)res, file_size - done.chunk * CHUNK);
+        }
+#else
+        (void)i;
+#endif
+    }
+
+    int fd = -1;
+    bool direct = false;
+    bool uring = false;
+    bool fixed = false;
+    uint64_t file_size = 0;
+    std::array<Slot, DEPTH> slots{};
+#if defined(__linux__)
+    IoRing ring;
+#endif
+};
@@ -0,0 +1,229 @@
+#pragma once
+// Per-message flight recorder. The hot thread fills one 64-byte TraceRecord per
+// market-data message with its stage timestamps and size, the levels it touched,
+// the update ID and what the strategy decided. Records go into a fixed in-memory
+// ring. A dump thread writes the ring to disk:
+//   - on demand:        kill -USR1 <pid>
+//   - at shutdown:      SIGINT / SIGTERM, then shutdown_requested() ends the
+//                       hot loop and main unwinds (a second signal exits at once)
+//   - on a slow message: --trace-threshold-us, once the messages after it are in
+// The dump is a raw header + records file; TraceExport turns it into Chrome
+// trace / Perfetto JSON. Dumping copies the ring and writes it from the dump
+// thread; if that thread shares a core with the hot thread, the dump itself
+// shows up as a stall of a few ms in the trace.
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stop_token>
+#include <string>
+#include <thread>
+#include <vector>
+#include <pthread.h>
+#include <unistd.h>
+
+// --- 1. RECORD FORMAT ---
+enum class TraceOutcome : uint8_t {
+    APPLIED,    // book updated, strategy not reached
+    STALE,      // already contained in the snapshot
+    SNAPSHOT,   // in-band snapshot loaded
+    DROPPED,    // waiting for a snapshot (in-band, or a REST retry)
+    RESYNC,     // book invalid, resynchronised
+    CONFLATED,  // behind the feed: strategy skipped
+    COOLDOWN,
+    UNCHANGED,  // top levels unchanged since the strategy last did nothing
+    NO_SIGNAL,
+    ORDER,
+    REJECT,     // risk rejected the order
+};
+
+inline const char* to_string(TraceOutcome o) {
+    static constexpr const char* names[] = {"applied", "stale", "snapshot", "dropped", "resync", "conflated",
+                                            "cooldown", "unchanged", "no_signal", "order", "reject"};
+    return (size_t)o < std::size(names) ? names[(size_t)o] : "?";
+}
+
+// Stage times are wall-clock ns; all but recv_ns are offsets from read_ns so
+// the record stays one cache line. A stage the message never reached is 0.
+struct alignas(64) TraceRecord {
+    static constexpr uint8_t SELL = 1;    // ORDER / REJECT side (BUY otherwise)
+    static constexpr uint8_t BREACH = 2;  // over the latency threshold
+
+    uint64_t seq;
+    int64_t recv_ns;    // kernel receive timestamp (0 if the transport has none)
+    int64_t read_ns;    // read() returned
+    int32_t parse_ns;   // levels parsed
+    int32_t apply_ns;   // book updated, or reloaded (SNAPSHOT; RESYNC including its REST fetch)
+    int32_t decide_ns;  // strategy decided
+    int32_t send_ns;    // order handed to the gateway
+    int64_t update_id;
+    uint32_t bytes;
+    uint32_t pending;   // transport bytes queued behind this message
+    uint16_t levels;    // price levels changed
+    TraceOutcome outcome;
+    uint8_t flags;
+};
+static_assert(sizeof(TraceRecord) == 64);
+
+struct TraceFileHeader {
+    static constexpr char MAGIC[8] = {'H', 'F', 'T', 'T', 'R', 'A', 'C', 'E'};
+    static constexpr uint32_t VERSION = 1;
+
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    uint64_t count;
+    int64_t threshold_ns;
+    char reason[16];
+};
+
+// --- 2. RING ---
+class FlightRecorder {
+public:
+    static constexpr size_t MIN_RECORDS = 1024;
+
+    // Rounded up to a power of two, and to at least MIN_RECORDS; 65536 records = 4 MiB
+    FlightRecorder(size_t records, std::string dir, long long threshold_ns)
+        : ring(std::bit_ceil(std::max(records, MIN_RECORDS))), mask(ring.size() - 1),
+          dir(std::move(dir)), threshold_ns(threshold_ns) {}
+
+    FlightRecorder(const FlightRecorder&) = delete;
+    FlightRecorder& operator=(const FlightRecorder&) = delete;
+
+    // Blocks the dump signals in the calling thread and in every thread it
+    // starts afterwards, so they are only ever delivered to run(). Call from
+    // main before any other thread exists.
+    static void block_signals() {
+        sigset_t set = signals();
+        pthread_sigmask(SIG_BLOCK, &set, nullptr);
+    }
+
+    // Hot thread: starts the record for a new message. The previous record is
+    // complete at this point and becomes visible to dumps.
+    TraceRecord& begin(long long recv_ns, long long read_ns, size_t bytes) {
+        published.store(cursor, std::memory_order_release);
+        TraceRecord& r = ring[cursor & mask];
+        r = TraceRecord{};
+        r.seq = cursor++;
+        r.recv_ns = recv_ns;
+        r.read_ns = read_ns;
+        r.bytes = (uint32_t)bytes;
+        return r;
+    }
+
+    // Hot thread: completes a record, whatever its outcome, flagging it if it
+    // breached the threshold.
+    void finish(TraceRecord& r) {
+        long long total = std::max({r.apply_ns, r.decide_ns, r.send_ns}) + (r.recv_ns ? r.read_ns - r.recv_ns : 0);
+        if (threshold_ns && total > threshold_ns) {
+            r.flags |= TraceRecord::BREACH;
+            if (breach_at.load(std::memory_order_relaxed) == 0) breach_at.store(r.seq + 1, std::memory_order_relaxed);
+        }
+        published.store(cursor, std::memory_order_release);
+    }
+
+    // Set once SIGINT / SIGTERM has been handled; the hot loop polls it.
+    bool shutdown_requested() const { return shutdown.load(std::memory_order_relaxed); }
+    const std::atomic<bool>& shutdown_flag() const { return shutdown; }
+
+    // --- 3. DUMPS ---
+    // Dump thread: waits for signals and threshold breaches
+    void run(std::stop_token stop) {
+        sigset_t set = signals();
+        struct sigaction sa{};
+        sa.sa_handler = [](int sig) { pending_signal.store(sig, std::memory_order_relaxed); };
+        sigemptyset(&sa.sa_mask);
+        for (int sig : {SIGUSR1, SIGINT, SIGTERM}) sigaction(sig, &sa, nullptr);
+        pthread_sigmask(SIG_UNBLOCK, &set, nullptr);
+
+        auto breach_seen = std::chrono::steady_clock::time_point{};
+        auto last_breach_dump = std::chrono::steady_clock::time_point{};
+        while (!stop.stop_requested()) {
+            // Polls: the handler only sets pending_signal, and sleep_for resumes after EINTR
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            int sig = pending_signal.exchange(0, std::memory_order_relaxed);
+            if (sig == SIGUSR1) dump("request");
+            else if (sig == SIGINT || sig == SIGTERM) {
+                if (shutdown_requested()) std::_Exit(128 + sig); // a second signal: main is stuck unwinding
+                dump("shutdown");
+                shutdown.store(true, std::memory_order_relaxed);
+            }
+
+            uint64_t at = breach_at.load(std::memory_order_relaxed);
+            if (at == 0) continue;
+            auto now = std::chrono::steady_clock::now();
+            if (now - last_breach_dump < std::chrono::seconds(1)) { // at most one per second
+                breach_at.store(0, std::memory_order_relaxed);
+                continue;
+            }
+            if (breach_seen == std::chrono::steady_clock::time_point{}) breach_seen = now;
+            // Capture what followed the slow message too: a quarter ring or 100 ms
+            if (published.load(std::memory_order_acquire) < at + ring.size() / 4 &&
+                now - breach_seen < std::chrono::milliseconds(100)) continue;
+            dump("latency");
+            last_breach_dump = now;
+            breach_seen = {};
+            breach_at.store(0, std::memory_order_relaxed);
+        }
+    }
+
+private:
+    static sigset_t signals() {
+        sigset_t set;
+        sigemptyset(&set);
+        sigaddset(&set, SIGUSR1);
+        sigaddset(&set, SIGINT);
+        sigaddset(&set, SIGTERM);
+        return set;
+    }
+
+    // Seqlock-style copy while the hot thread keeps writing: the slot of
+    // record i is reused by record i + N, and the writer may be filling any
+    // record up to the end count re-read after the copy. Records below
+    // end + 1 - N can therefore have been overwritten mid-copy and are dropped.
+    void dump(const char* reason) {
+        uint64_t begin_count = published.load(std::memory_order_acquire);
+        std::vector<TraceRecord> copy(ring.begin(), ring.end());
+        std::atomic_thread_fence(std::memory_order_acquire);
+        uint64_t end_count = published.load(std::memory_order_relaxed);
+        uint64_t first = end_count + 1 > ring.size() ? end_count + 1 - ring.size() : 0;
+        uint64_t n = begin_count > first ? begin_count - first : 0;
+
+        auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        std::string path = dir + "/flight_" + std::to_string(getpid()) + "_" + std::to_string(ms) + "_" + reason + ".trace";
+        std::ofstream out(path, std::ios::binary);
+        TraceFileHeader h{};
+        std::memcpy(h.magic, TraceFileHeader::MAGIC, sizeof(h.magic));
+        h.version = TraceFileHeader::VERSION;
+        h.record_size = sizeof(TraceRecord);
+        h.count = n;
+        h.threshold_ns = threshold_ns;
+        std::snprintf(h.reason, sizeof(h.reason), "%s", reason);
+        out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+        for (uint64_t i = first; i < first + n; i++) {
+            out.write(reinterpret_cast<const char*>(&copy[i & mask]), sizeof(TraceRecord));
+        }
+        if (out) std::cerr << "[TRACE] Wrote " << n << " records (" << reason << ") to " << path << std::endl;
+        else std::cerr << "[TRACE] Failed to write " << path << std::endl;
+    }
+
+    std::vector<TraceRecord> ring;
+    size_t mask;
+    std::string dir;
+    long long threshold_ns;
+
+    // Written by the hot thread
+    alignas(64) uint64_t cursor = 0;                 // record being filled
+    std::atomic<uint64_t> published{0};              // records [0, published) are complete
+    alignas(64) std::atomic<uint64_t> breach_at{0}; // 1 + seq of the first unhandled breach
+    std::atomic<bool> shutdown{false};               // written by the dump thread, rarely
+    inline static std::atomic<int> pending_signal{0};
+};
@@ -0,0 +1,433 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <thread>
+#include <atomic>
+#include <bit>
+#include <filesystem>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "recording.hpp"
+
+// Synthetic Binance depthUpdate streams for stress benchmarks. Output is a
+// normal recording (plain text or LZ4/zstd blocks) that the Backtester and the
+// feature extractor replay like live data, starting with a snapshot record.
+// With --udp the same stream goes out as one datagram per message instead, for
+// the engine's packet-ring transport (e.g. across a veth pair), with a snapshot
+// repeated every --snapshot-every messages so a receiver can always resync.
+
+// --- 1. RANDOM NUMBERS ---
+// xoshiro256**: a few cycles per draw, far cheaper than std::mt19937_64 + distributions.
+class FastRng {
+public:
+    explicit FastRng(uint64_t seed) {
+        for (auto& s : state) {
+            seed += 0x9E3779B97F4A7C15ull; // splitmix64 seeding
+            uint64_t z = seed;
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            s = z ^ (z >> 31);
+        }
+    }
+
+    uint64_t next() {
+        uint64_t result = rotl(state[1] * 5, 7) * 9;
+        uint64_t t = state[1] << 17;
+        state[2] ^= state[0];
+        state[3] ^= state[1];
+        state[1] ^= state[2];
+        state[0] ^= state[3];
+        state[2] ^= t;
+        state[3] = rotl(state[3], 45);
+        return result;
+    }
+
+    double uniform() { return (next() >> 11) * 0x1.0p-53; }                // [0, 1)
+    double exponential(double mean) { return -mean * std::log1p(-uniform()); }
+    int below(int n) { return (int)((next() >> 32) * (uint64_t)n >> 32); }  // [0, n)
+
+    // Unit exponential from a quantile table: no log() per draw, tail cut at ~9.7
+    // means. Good enough for level distances and sizes; the clock uses exponential().
+    double exponential_fast() {
+        static const std::vector<double> table = [] {
+            std::vector<double> t(1 << 14);
+            for (size_t i = 0; i < t.size(); i++) t[i] = -std::log1p(-(i + 0.5) / t.size());
+            return t;
+        }();
+        return table[next() >> 50];
+    }
+
+private:
+    static uint64_t rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+    uint64_t state[4];
+};
+
+// --- 2. SCENARIO ---
+struct GeneratorConfig {
+    long long messages = 10'000'000;
+    uint64_t seed = 1;
+
+    // Hawkes arrivals: lambda(t) = mu + sum(alpha * exp(-beta * (t - t_i)))
+    double mu = 200.0;            // baseline messages per second
+    double alpha = 150.0;         // jump in intensity per message
+    double beta = 200.0;          // decay rate (1/s); alpha/beta < 1 keeps it stationary
+
+    double mean_distance = 20.0;  // mean ticks from the touch for updated levels
+    double cancel_prob = 0.35;    // share of level updates that delete the level
+    double mean_qty = 0.25;       // BTC per resting level
+    int max_levels = 8;           // per message and side
+    double move_prob = 0.05;      // chance the mid moves one tick per message
+
+    // Cancellation bursts: every `burst_every` seconds, `burst_len` seconds of mass cancels
+    double burst_every = 60.0;
+    double burst_len = 2.0;
+    double burst_cancel_prob = 0.9;
+
+    // Flash crash: at `crash_at` seconds the mid falls `crash_pct` within `crash_len` seconds and then recovers
+    double crash_at = 0.0;        // 0 = none
+    double crash_pct = 5.0;
+    double crash_len = 10.0;
+
+    int64_t start_ns = 1700000000000000000LL;
+    int64_t start_price_ticks = 9000000; // 90000.00 with 0.01 ticks
+};
+
+// --- 3. ORDER FLOW MODEL ---
+class FlowGenerator {
+public:
+    static constexpr int MIN_WINDOW = 1 << 20;
+    static constexpr double MAX_CRASH_PCT = 50.0; // deeper crashes would need a window of hundreds of MB
+
+    // Price ticks tracked around the start price. The mid stays in the middle
+    // half, which must hold the crash depth plus room for the random walk.
+    static int window_for(const GeneratorConfig& cfg) {
+        int64_t depth = cfg.crash_at > 0 ? (int64_t)(cfg.start_price_ticks * cfg.crash_pct / 100.0) : 0;
+        return (int)std::bit_ceil((uint64_t)std::max<int64_t>(MIN_WINDOW, 4 * (depth + MIN_WINDOW / 8)));
+    }
+
+    explicit FlowGenerator(const GeneratorConfig& cfg)
+        : cfg(cfg), rng(cfg.seed), window(window_for(cfg)), qty(window, 0), mid(window / 2), t_ns(cfg.start_ns) {
+        msg.reserve(4096);
+    }
+
+    // Seeds a two-sided book and returns it as a REST-style snapshot record.
+    std::string_view snapshot(int levels_per_side = 500) {
+        msg.clear();
+        append("{\"lastUpdateId\":");
+        append_int(update_id);
+        append(",\"bids\":[");
+        for (int d = 1; d <= levels_per_side; d++) {
+            qty[mid - d] = random_qty();
+            append_level(mid - d, qty[mid - d], d == 1);
+        }
+        append("],\"asks\":[");
+        for (int d = 1; d <= levels_per_side; d++) {
+            qty[mid + d] = random_qty();
+            append_level(mid + d, qty[mid + d], d == 1);
+        }
+        append("]}");
+        return {msg.data(), msg.size()};
+    }
+
+    // The current top levels as a snapshot record, for mid-stream resyncs; leaves the book as is.
+    std::string_view book_snapshot(int levels_per_side) {
+        msg.clear();
+        append("{\"lastUpdateId\":");
+        append_int(update_id);
+        append(",\"bids\":[");
+        for (int t = mid - 1, n = 0; t >= 0 && n < levels_per_side; t--) {
+            if (qty[t] > 0) append_level(t, qty[t], n++ == 0);
+        }
+        append("],\"asks\":[");
+        for (int t = mid + 1, n = 0; t < window && n < levels_per_side; t++) {
+            if (qty[t] > 0) append_level(t, qty[t], n++ == 0);
+        }
+        append("]}");
+        return {msg.data(), msg.size()};
+    }
+
+    int64_t now_ns() const { return t_ns; }
+
+    // Advances the Hawkes clock and builds the next depthUpdate.
+    std::string_view next() {
+        advance_clock();
+        double secs = (t_ns - cfg.start_ns) * 1e-9;
+        double cancel = in_burst(secs) ? cfg.burst_cancel_prob : cfg.cancel_prob;
+
+        bids.clear();
+        asks.clear();
+        move_mid(secs);
+
+        int nb = 1 + rng.below(cfg.max_levels);
+        int na = 1 + rng.below(cfg.max_levels);
+        for (int i = 0; i < nb; i++) touch_level(mid - 1 - distance(), cancel, bids);
+        for (int i = 0; i < na; i++) touch_level(mid + 1 + distance(), cancel, asks);
+
+        long long first = update_id + 1;
+        update_id += std::max<size_t>(1, bids.size() + asks.size());
+
+        msg.clear();
+        append("{\"e\":\"depthUpdate\",\"E\":");
+        append_int(t_ns / 1000000);
+        append(",\"s\":\"BTCUSD\",\"U\":");
+        append_int(first);
+        append(",\"u\":");
+        append_int(update_id);
+        append(",\"b\":[");
+        for (size_t i = 0; i < bids.size(); i++) append_level(bids[i].tick, bids[i].qty, i == 0);
+        append("],\"a\":[");
+        for (size_t i = 0; i < asks.size(); i++) append_level(asks[i].tick, asks[i].qty, i == 0);
+        append("]}");
+        return {msg.data(), msg.size()};
+    }
+
+private:
+    struct Change { int tick; int64_t qty; };
+
+    // Dassios-Zhao exact simulation of an exponential-kernel Hawkes process: O(1) per event.
+    void advance_clock() {
+        double w = rng.exponential(1.0 / cfg.mu);
+        if (excitation > 0) {
+            double d = 1.0 + cfg.beta * std::log(1.0 - rng.uniform()) / excitation;
+            if (d > 0) w = std::min(w, -std::log(d) / cfg.beta);
+        }
+        excitation = excitation * std::exp(-cfg.beta * w) + cfg.alpha;
+        t_ns += std::max<int64_t>(1, (int64_t)(w * 1e9));
+    }
+
+    bool in_burst(double secs) const {
+        return cfg.burst_every > 0 && std::fmod(secs, cfg.burst_every) >= cfg.burst_every - cfg.burst_len;
+    }
+
+    int distance() {
+        int d = (int)(rng.exponential_fast() * cfg.mean_distance);
+        return std::min(d, window / 4);
+    }
+
+    int64_t random_qty() { return 1 + (int64_t)(rng.exponential_fast() * cfg.mean_qty * 1e8); }
+
+    void touch_level(int tick, double cancel, std::vector<Change>& out) {
+        tick = std::clamp(tick, 0, window - 1); // the mid at its clamp plus a far level can leave the window
+        for (const Change& c : out) if (c.tick == tick) return; // one change per level and message
+        int64_t q = (qty[tick] > 0 && rng.uniform() < cancel) ? 0 : random_qty();
+        qty[tick] = q;
+        out.push_back({tick, q});
+    }
+
+    // Random walk, plus the flash-crash path: linear fall then linear recovery.
+    void move_mid(double secs) {
+        int target = mid;
+        if (cfg.crash_at > 0 && secs >= cfg.crash_at && secs < cfg.crash_at + 2 * cfg.crash_len) {
+            double depth = cfg.start_price_ticks * cfg.crash_pct / 100.0;
+            double phase = (secs - cfg.crash_at) / cfg.crash_len;
+            double drop = phase < 1.0 ? phase : 2.0 - phase;
+            target = window / 2 + drift - (int)(depth * drop);
+            if (target == mid) return;
+        } else if (rng.uniform() < cfg.move_prob) {
+            drift += rng.below(2) ? 1 : -1;
+            target = window / 2 + drift;
+        } else {
+            return;
+        }
+        target = std::clamp(target, window / 4, 3 * window / 4);
+
+        // Levels the new mid runs through are removed so the book never crosses
+        while (mid < target) {
+            mid++;
+            if (qty[mid] > 0) { qty[mid] = 0; asks.push_back({mid, 0}); }
+        }
+        while (mid > target) {
+            mid--;
+            if (qty[mid] > 0) { qty[mid] = 0; bids.push_back({mid, 0}); }
+        }
+    }
+
+    void append(std::string_view s) { msg.append(s); }
+
+    void append_int(long long v) {
+        char buf[24];
+        auto [end, ec] = std::to_chars(buf, buf + sizeof(buf), v);
+        msg.append(buf, end);
+    }
+
+    // Fixed-point decimal: `v` in units of 10^-digits
+    void append_fixed(int64_t v, int digits, int64_t scale) {
+        append_int(v / scale);
+        msg.push_back('.');
+        char buf[24];
+        int64_t frac = v % scale;
+        for (int i = digits - 1; i >= 0; i--) { buf[i] = char('0' + frac % 10); frac /= 10; }
+        msg.append(buf, digits);
+    }
+
+    void append_level(int tick, int64_t q, bool first) {
+        if (!first) msg.push_back(',');
+        append("[\"");
+        append_fixed(cfg.start_price_ticks + (tick - window / 2), 2, 100);
+        append("\",\"");
+        append_fixed(q, 8, 100000000);
+        append("\"]");
+    }
+
+    GeneratorConfig cfg;
+    FastRng rng;
+    int window;
+    std::vector<int64_t> qty;   // resting quantity (1e-8 BTC) per price tick
+    int mid;
+    int drift = 0;              // random-walk offset of the mid from the start price
+    int64_t t_ns;
+    double excitation = 0.0;
+    long long update_id = 1000;
+    std::vector<Change> bids, asks;
+    std::string msg;
+};
+
+// --- 4. UDP SINK ---
+// One datagram per message to host:port, optionally paced to `rate` messages/s.
+class UdpSink {
+public:
+    bool open(const std::string& endpoint, double rate) {
+        size_t colon = endpoint.rfind(':');
+        if (colon == std::string::npos) return false;
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons((uint16_t)std::atoi(endpoint.c_str() + colon + 1));
+        if (inet_pton(AF_INET, endpoint.substr(0, colon).c_str(), &addr.sin_addr) != 1) return false;
+        fd = socket(AF_INET, SOCK_DGRAM, 0);
+        interval = rate > 0 ? std::chrono::nanoseconds((long long)(1e9 / rate)) : std::chrono::nanoseconds(0);
+        next = std::chrono::steady_clock::now();
+        return fd >= 0;
+    }
+
+    ~UdpSink() { if (fd >= 0) close(fd); }
+
+    void send(std::string_view m) {
+        if (interval.count() > 0) {
+            next += interval;
+            std::this_thread::sleep_until(next);
+        }
+        if (sendto(fd, m.data(), m.size(), 0, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) < 0) errors++;
+    }
+
+    long long errors = 0;
+
+private:
+    int fd = -1;
+    sockaddr_in addr{};
+    std::chrono::nanoseconds interval{0};
+    std::chrono::steady_clock::time_point next;
+};
+
+// --- 5. MAIN ---
+constexpr int UDP_SNAPSHOT_LEVELS = 20;
+
+int main(int argc, char** argv) {
+    GeneratorConfig cfg;
+    std::string out_path = "synthetic.log";
+    Codec codec = Codec::NONE;
+    bool null_sink = false;  // generate only, to measure the generator itself
+    unsigned threads = 1;    // independent streams, one file each, different seeds
+    std::string udp_endpoint; // host:port; sends datagrams instead of writing a file
+    double rate = 0.0;        // --udp pacing in messages/s (0 = as fast as possible)
+    long long snapshot_every = 1000; // --udp: resend a snapshot every N messages (0 = only the first)
+
+    for (int i = 1; i < argc; i++) {
+        auto arg = [&](const char* name) { return std::strcmp(argv[i], name) == 0 && i + 1 < argc; };
+        if (arg("--messages")) cfg.messages = std::atoll(argv[++i]);
+        else if (arg("--seed")) cfg.seed = std::strtoull(argv[++i], nullptr, 10);
+        else if (arg("--mu")) cfg.mu = std::atof(argv[++i]);
+        else if (arg("--alpha")) cfg.alpha = std::atof(argv[++i]);
+        else if (arg("--beta")) cfg.beta = std::atof(argv[++i]);
+        else if (arg("--mean-distance")) cfg.mean_distance = std::atof(argv[++i]);
+        else if (arg("--cancel-prob")) cfg.cancel_prob = std::atof(argv[++i]);
+        else if (arg("--max-levels")) cfg.max_levels = std::max(1, std::atoi(argv[++i]));
+        else if (arg("--move-prob")) cfg.move_prob = std::atof(argv[++i]);
+        else if (arg("--burst-every")) cfg.burst_every = std::atof(argv[++i]);
+        else if (arg("--burst-len")) cfg.burst_len = std::atof(argv[++i]);
+        else if (arg("--crash-at")) cfg.crash_at = std::atof(argv[++i]);
+        else if (arg("--crash-pct")) cfg.crash_pct = std::atof(argv[++i]);
+        else if (arg("--crash-len")) cfg.crash_len = std::atof(argv[++i]);
+        else if (arg("--out")) out_path = argv[++i];
+        else if (arg("--codec")) codec = parse_codec(argv[++i]);
+        else if (arg("--threads")) threads = (unsigned)std::max(1, std::atoi(argv[++i]));
+        else if (arg("--udp")) udp_endpoint = argv[++i];
+        else if (arg("--rate")) rate = std::atof(argv[++i]);
+        else if (arg("--snapshot-every")) snapshot_every = std::atoll(argv[++i]);
+        else if (std::strcmp(argv[i], "--null") == 0) null_sink = true;
+    }
+    if (cfg.crash_at > 0 && !(cfg.crash_pct > 0 && cfg.crash_pct <= FlowGenerator::MAX_CRASH_PCT)) {
+        std::cerr << "Error: --crash-pct must be in (0, " << FlowGenerator::MAX_CRASH_PCT << "]" << std::endl;
+        return 1;
+    }
+
+    if (!udp_endpoint.empty()) {
+        UdpSink sink;
+        if (!sink.open(udp_endpoint, rate)) {
+            std::cerr << "Error: bad --udp endpoint " << udp_endpoint << std::endl;
+            return 1;
+        }
+        FlowGenerator gen(cfg);
+        // A shallow snapshot keeps every datagram within a 1500-byte MTU. The engine has
+        // no other way to resync after a lost datagram or a late start, so it is repeated.
+        sink.send(gen.snapshot(UDP_SNAPSHOT_LEVELS));
+        for (long long i = 0; i < cfg.messages; i++) {
+            sink.send(gen.next());
+            if (snapshot_every > 0 && (i + 1) % snapshot_every == 0) sink.send(gen.book_snapshot(UDP_SNAPSHOT_LEVELS));
+        }
+        std::cout << "[GENERATOR] " << cfg.messages << " datagrams -> " << udp_endpoint
+                  << " (" << sink.errors << " send errors)" << std::endl;
+        return 0;
+    }
+
+    std::cout << "[GENERATOR] " << cfg.messages << " messages x " << threads << " streams"
+              << (null_sink ? " (null sink)" : " -> " + out_path) << std::endl;
+
+    std::atomic<long long> bytes{0};
+    auto run_stream = [&](unsigned stream) {
+        GeneratorConfig c = cfg;
+        c.seed = cfg.seed + stream;
+        std::string path = threads == 1 ? out_path : out_path + "." + std::to_string(stream);
+        FlowGenerator gen(c);
+        MarketRecorder recorder;
+        if (!null_sink) {
+            // The recorder appends (live sessions accumulate); a generated run starts fresh
+            std::filesystem::remove(path);
+            std::filesystem::remove(path + ".idx");
+        }
+        if (!null_sink && !recorder.open(path, codec, RecordMode::ARCHIVE)) {
+            std::cerr << "Error: cannot write " << path << std::endl;
+            return;
+        }
+
+        long long total = 0;
+        std::string_view snap = gen.snapshot();
+        if (!null_sink) recorder.record(gen.now_ns(), snap);
+        for (long long i = 0; i < c.messages; i++) {
+            std::string_view m = gen.next();
+            total += m.size();
+            if (!null_sink) recorder.record(gen.now_ns(), m);
+        }
+        recorder.close();
+        bytes += total;
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> pool;
+    for (unsigned s = 0; s < threads; s++) pool.emplace_back(run_stream, s);
+    for (auto& t : pool) t.join();
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    double total_msgs = (double)cfg.messages * threads;
+    std::cout << "[GENERATOR] " << total_msgs / secs / 1e6 << " M msg/s, "
+              << bytes / secs / 1e6 << " MB/s of JSON in " << secs << " s" << std::endl;
+    return 0;
+}
@@ -0,0 +1,444 @@
+#pragma once
+// Order book for very deep books (limit=5000 snapshots, thin alt-coin books with
+// tens of thousands of levels). The sorted-vector OrderBook pays a memmove of the
+// whole side behind every mid-book insert/delete; here each side is
+//
+//   hot:  a small sorted array holding the best levels (what the strategy reads)
+//   cold: a B+tree with 512-byte nodes for everything behind it
+//
+// Levels are demoted from hot to cold when an insert overflows the window and
+// promoted back in bulk when deletes drain it. Same interface as OrderBook;
+// selected in the live engine with -DHFT_HYBRID_BOOK=1.
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <memory_resource>
+#include <new>
+#include <span>
+#include <vector>
+#include "order_book.hpp"
+
+// --- B+TREE OF PRICE LEVELS ---
+// Keys are side-normalised prices (ask price, -bid price), so the best level is
+// always the smallest key and both sides share one tree. Nodes come from the
+// given memory resource and are recycled through free lists, so a monotonic
+// arena does not grow under churn.
+class LevelTree {
+public:
+    static constexpr int LEAF_CAP = 30;  // 24-byte header + 30 x (key, qty) -> 512 B
+    static constexpr int INNER_CAP = 31; // 8-byte header + 31 keys + 32 children = 512 B
+
+    explicit LevelTree(std::pmr::memory_resource* pool) : pool(pool) {}
+    LevelTree(const LevelTree&) = delete;
+    LevelTree& operator=(const LevelTree&) = delete;
+    ~LevelTree() {
+        clear();
+        while (free_leaves) { Leaf* l = free_leaves; free_leaves = l->next; pool->deallocate(l, sizeof(Leaf), alignof(Leaf)); }
+        while (free_inners) { Inner* in = free_inners; free_inners = static_cast<Inner*>(in->child[0]); pool->deallocate(in, sizeof(Inner), alignof(Inner)); }
+    }
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+
+    // Sets the quantity at `key`; a quantity <= 0.0000001 removes the level.
+    void assign(double key, double qty) {
+        if (!root) {
+            if (qty <= 0.0000001) return;
+            Leaf* l = new_leaf();
+            root = head = l;
+            height = 0;
+        }
+
+        PathEntry path[MAX_HEIGHT];
+        int depth = 0;
+        void* node = root;
+        for (int h = height; h > 0; h--) {
+            Inner* in = static_cast<Inner*>(node);
+            int i = int(std::upper_bound(in->keys, in->keys + in->n, key) - in->keys);
+            path[depth++] = {in, i};
+            node = in->child[i];
+        }
+
+        Leaf* leaf = static_cast<Leaf*>(node);
+        int pos = int(std::lower_bound(leaf->keys, leaf->keys + leaf->n, key) - leaf->keys);
+        bool hit = pos < leaf->n && leaf->keys[pos] == key;
+        if (hit) {
+            if (qty > 0.0000001) leaf->qty[pos] = qty;
+            else erase_at(leaf, pos, path, depth);
+        } else if (qty > 0.0000001) {
+            insert_at(leaf, pos, key, qty, path, depth);
+        }
+    }
+
+    // Removes and returns the best (smallest-key) level.
+    bool pop_front(double& key, double& qty) {
+        if (count == 0) return false;
+        key = head->keys[0];
+        qty = head->qty[0];
+        assign(key, 0.0);
+        return true;
+    }
+
+    // Calls fn(key, qty) best-first until it returns false.
+    template <class Fn>
+    void for_each(Fn&& fn) const {
+        for (const Leaf* l = head; l; l = l->next) {
+            for (int i = 0; i < l->n; i++) if (!fn(l->keys[i], l->qty[i])) return;
+        }
+    }
+
+    void clear() {
+        if (root) free_subtree(root, height);
+        root = nullptr;
+        head = nullptr;
+        height = 0;
+        count = 0;
+    }
+
+private:
+    static constexpr int MAX_HEIGHT = 16;
+
+    struct alignas(64) Leaf {
+        int n;
+        Leaf* next;
+        Leaf* prev;
+        double keys[LEAF_CAP];
+        double qty[LEAF_CAP];
+    };
+    struct alignas(64) Inner {
+        int n; // keys; children = n + 1. keys[i] <= every key under child[i + 1]
+        double keys[INNER_CAP];
+        void* child[INNER_CAP + 1];
+    };
+    struct PathEntry { Inner* node; int idx; };
+
+    Leaf* new_leaf() {
+        Leaf* l = free_leaves;
+        if (l) free_leaves = l->next;
+        else l = static_cast<Leaf*>(pool->allocate(sizeof(Leaf), alignof(Leaf)));
+        l->n = 0;
+        l->next = l->prev = nullptr;
+        return l;
+    }
+    Inner* new_inner() {
+        Inner* in = free_inners;
+        if (in) free_inners = static_cast<Inner*>(in->child[0]);
+        else in = static_cast<Inner*>(pool->allocate(sizeof(Inner), alignof(Inner)));
+        in->n = 0;
+        return in;
+    }
+    void free_leaf(Leaf* l) { l->next = free_leaves; free_leaves = l; }
+    void free_inner(Inner* in) { in->child[0] = free_inners; free_inners = in; }
+
+    void free_subtree(void* node, int h) {
+        if (h == 0) { free_leaf(static_cast<Leaf*>(node)); return; }
+        Inner* in = static_cast<Inner*>(node);
+        for (int i = 0; i <= in->n; i++) free_subtree(in->child[i], h - 1);
+        free_inner(in);
+    }
+
+    void insert_at(Leaf* leaf, int pos, double key, double qty, PathEntry* path, int depth) {
+        count++;
+        if (leaf->n < LEAF_CAP) {
+            std::copy_backward(leaf->keys + pos, leaf->keys + leaf->n, leaf->keys + leaf->n + 1);
+            std::copy_backward(leaf->qty + pos, leaf->qty + leaf->n, leaf->qty + leaf->n + 1);
+            leaf->keys[pos] = key;
+            leaf->qty[pos] = qty;
+            leaf->n++;
+            return;
+        }
+
+        // Split in half and insert into whichever side the key belongs to
+        Leaf* right = new_leaf();
+        int half = LEAF_CAP / 2;
+        right->n = LEAF_CAP - half;
+        std::copy(leaf->keys + half, leaf->keys + LEAF_CAP, right->keys);
+        std::copy(leaf->qty + half, leaf->qty + LEAF_CAP, right->qty);
+        leaf->n = half;
+        right->next = leaf->next;
+        right->prev = leaf;
+        if (leaf->next) leaf->next->prev = right;
+        leaf->next = right;
+
+        Leaf* target = pos <= half ? leaf : right;
+        int p = pos <= half ? pos : pos - half;
+        std::copy_backward(target->keys + p, target->keys + target->n, target->keys + target->n + 1);
+        std::copy_backward(target->qty + p, target->qty + target->n, target->qty + target->n + 1);
+        target->keys[p] = key;
+        target->qty[p] = qty;
+        target->n++;
+
+        insert_into_parent(path, depth, right->keys[0], right);
+    }
+
+    void insert_into_parent(PathEntry* path, int depth, double sep, void* right) {
+        while (true) {
+            if (depth == 0) {
+                Inner* r = new_inner();
+                r->n = 1;
+                r->keys[0] = sep;
+                r->child[0] = root;
+                r->child[1] = right;
+                root = r;
+                height++;
+                return;
+            }
+            auto [in, i] = path[--depth];
+            if (in->n < INNER_CAP) {
+                std::copy_backward(in->keys + i, in->keys + in->n, in->keys + in->n + 1);
+                std::copy_backward(in->child + i + 1, in->child + in->n + 1, in->child + in->n + 2);
+                in->keys[i] = sep;
+                in->child[i + 1] = right;
+                in->n++;
+                return;
+            }
+
+            // Full inner node: split around the middle key, which moves up
+            double keys[INNER_CAP + 1];
+            void* child[INNER_CAP + 2];
+            std::copy(in->keys, in->keys + i, keys);
+            keys[i] = sep;
+            std::copy(in->keys + i, in->keys + INNER_CAP, keys + i + 1);
+            std::copy(in->child, in->child + i + 1, child);
+            child[i + 1] = right;
+            std::copy(in->child + i + 1, in->child + INNER_CAP + 1, child + i + 2);
+
+            constexpr int mid = (INNER_CAP + 1) / 2;
+            Inner* r = new_inner();
+            in->n = mid;
+            std::copy(keys, keys + mid, in->keys);
+            std::copy(child, child + mid + 1, in->child);
+            r->n = INNER_CAP - mid;
+            std::copy(keys + mid + 1, keys + INNER_CAP + 1, r->keys);
+            std::copy(child + mid + 1, child + INNER_CAP + 2, r->child);
+            sep = keys[mid];
+            right = r;
+        }
+    }
+
+    void erase_at(Leaf* leaf, int pos, PathEntry* path, int depth) {
+        count--;
+        std::copy(leaf->keys + pos + 1, leaf->keys + leaf->n, leaf->keys + pos);
+        std::copy(leaf->qty + pos + 1, leaf->qty + leaf->n, leaf->qty + pos);
+        leaf->n--;
+        if (depth == 0) return; // a root leaf may be empty
+
+        // Separators may go stale-low after a delete; descent stays correct.
+        auto [parent, idx] = path[depth - 1];
+        if (leaf->n == 0) {
+            unlink(leaf);
+            free_leaf(leaf);
+            remove_child(path, depth - 1);
+            return;
+        }
+        // Sparse leaf: fold the right sibling in when both fit comfortably
+        if (leaf->n < LEAF_CAP / 4 && idx < parent->n) {
+            Leaf* right = static_cast<Leaf*>(parent->child[idx + 1]);
+            if (leaf->n + right->n <= LEAF_CAP * 3 / 4) {
+                std::copy(right->keys, right->keys + right->n, leaf->keys + leaf->n);
+                std::copy(right->qty, right->qty + right->n, leaf->qty + leaf->n);
+                leaf->n += right->n;
+                unlink(right);
+                free_leaf(right);
+                path[depth - 1].idx = idx + 1;
+                remove_child(path, depth - 1);
+            }
+        }
+    }
+
+    void unlink(Leaf* l) {
+        if (l->prev) l->prev->next = l->next;
+        else head = l->next;
+        if (l->next) l->next->prev = l->prev;
+    }
+
+    // Drops child path[level].idx from its inner node, collapsing empty nodes upwards.
+    void remove_child(PathEntry* path, int level) {
+        while (true) {
+            auto [in, i] = path[level];
+            if (in->n == 0) { // its only child is gone
+                free_inner(in);
+                if (level == 0) { root = nullptr; head = nullptr; height = 0; return; }
+                level--;
+                continue;
+            }
+            int k = i > 0 ? i - 1 : 0;
+            std::copy(in->keys + k + 1, in->keys + in->n, in->keys + k);
+            std::copy(in->child + i + 1, in->child + in->n + 1, in->child + i);
+            in->n--;
+            if (level == 0 && in->n == 0) { // root with one child: shrink the tree
+                root = in->child[0];
+                height--;
+                free_inner(in);
+            }
+            return;
+        }
+    }
+
+    std::pmr::memory_resource* pool;
+    void* root = nullptr;
+    Leaf* head = nullptr;
+    int height = 0; // inner levels above the leaves
+    size_t count = 0;
+    Leaf* free_leaves = nullptr;
+    Inner* free_inners = nullptr;
+};
+
+// --- HYBRID ORDER BOOK ---
+class HybridOrderBook {
+public:
+    static constexpr size_t HOT_CAP = 64;    // best levels kept in the flat window
+    static constexpr size_t HOT_REFILL = 32; // refill target after the window drains
+    static constexpr size_t HOT_LOW = 16;    // refill when fewer remain
+
+    explicit HybridOrderBook(std::pmr::memory_resource* pool) : sides{HalfBook(pool), HalfBook(pool)} {}
+
+    void update_bid(double price, double qty) { update<BidSide>(price, qty); }
+    void update_ask(double price, double qty) { update<AskSide>(price, qty); }
+
+    void apply_update(std::span<Level> bid_changes, std::span<Level> ask_changes) {
+        for (const Level& l : bid_changes) update_bid(l.price, l.quantity);
+        for (const Level& l : ask_changes) update_ask(l.price, l.quantity);
+    }
+
+    void load_snapshot(simdjson::dom::array& bid_array, simdjson::dom::array& ask_array, bool announce = true) {
+        if (announce) std::cout << "[SNAPSHOT] Loading " << bid_array.size() << " bids and " << ask_array.size() << " asks..." << std::endl;
+        std::vector<Level> levels;
+        parse_levels(bid_array, levels);
+        load_side<BidSide>(levels);
+        parse_levels(ask_array, levels);
+        load_side<AskSide>(levels);
+    }
+
+    double get_imbalance() const {
+        const HalfBook& bids = sides[side_index(Side::BUY)];
+        const HalfBook& asks = sides[side_index(Side::SELL)];
+        if (bids.n == 0 || asks.n == 0) return 0.5;
+        double bid_vol = 0, ask_vol = 0;
+        for (size_t i = 0; i < std::min((size_t)5, bids.n); i++) bid_vol += bids.qty[i];
+        for (size_t i = 0; i < std::min((size_t)5, asks.n); i++) ask_vol += asks.qty[i];
+        return bid_vol / (bid_vol + ask_vol);
+    }
+
+    double get_best(Side side) const {
+        const HalfBook& h = sides[side_index(side)];
+        return h.n == 0 ? 0.0 : KEY_SIGN[side_index(side)] * h.keys[0];
+    }
+    double get_best_bid() const { return get_best(Side::BUY); }
+    double get_best_ask() const { return get_best(Side::SELL); }
+
+    template <class Observer>
+    void apply_update(std::span<Level> bid_changes, std::span<Level> ask_changes, Observer& observer) {
+        apply_observed(*this, bid_changes, ask_changes, observer);
+    }
+
+    size_t top_levels(Side side, Level* out, size_t n) const {
+        size_t i = 0;
+        if (n > 0) for_each(side, [&](double price, double q) { out[i++] = {price, q}; return i < n; });
+        return i;
+    }
+
+    size_t depth(Side side) const { return sides[side_index(side)].n + sides[side_index(side)].cold.size(); }
+    size_t bid_depth() const { return depth(Side::BUY); }
+    size_t ask_depth() const { return depth(Side::SELL); }
+
+    using Sweep = OrderBook::Sweep;
+    Sweep sweep(Side order_side, double qty) const {
+        Sweep s{0.0, 0.0};
+        for_each(opposite_side(order_side), [&](double price, double q) {
+            double take = std::min(qty - s.filled, q);
+            s.filled += take;
+            s.notional += take * price;
+            return s.filled < qty;
+        });
+        return s;
+    }
+
+    // Bit-identical to OrderBook::checksum (negating a bid key restores its exact bits).
+    uint64_t checksum(size_t depth) const {
+        uint64_t h = 14695981039346656037ull;
+        auto mix = [&h](double v) { h = (h ^ std::bit_cast<uint64_t>(v)) * 1099511628211ull; };
+        auto side_hash = [&](Side side) {
+            size_t i = 0;
+            if (depth > 0) for_each(side, [&](double price, double q) { mix(price); mix(q); return ++i < depth; });
+        };
+        side_hash(Side::BUY);
+        mix(0.0);
+        side_hash(Side::SELL);
+        return h;
+    }
+
+private:
+    // Keys are Tag::sign * price; indexed by Side for the runtime-sided readers
+    static constexpr double KEY_SIGN[2] = {BidSide::sign, AskSide::sign};
+
+    struct HalfBook {
+        explicit HalfBook(std::pmr::memory_resource* pool) : cold(pool) {}
+        std::array<double, HOT_CAP> keys;
+        std::array<double, HOT_CAP> qty;
+        size_t n = 0;
+        LevelTree cold;  // every key here is greater than every hot key
+    };
+
+    template <class Fn>
+    void for_each(Side side, Fn&& fn) const {
+        const HalfBook& h = sides[side_index(side)];
+        double sign = KEY_SIGN[side_index(side)];
+        for (size_t i = 0; i < h.n; i++) if (!fn(sign * h.keys[i], h.qty[i])) return;
+        h.cold.for_each([&](double key, double q) { return fn(sign * key, q); });
+    }
+
+    template <class Tag>
+    void update(double price, double qty) {
+        HalfBook& s = sides[side_index(Tag::side)];
+        double key = Tag::sign * price;
+        if (s.n > 0 && key > s.keys[s.n - 1] && !s.cold.empty()) {
+            s.cold.assign(key, qty);
+            return;
+        }
+
+        size_t pos = std::lower_bound(s.keys.begin(), s.keys.begin() + s.n, key) - s.keys.begin();
+        if (pos < s.n && s.keys[pos] == key) {
+            if (qty > 0.0000001) { s.qty[pos] = qty; return; }
+            std::copy(s.keys.begin() + pos + 1, s.keys.begin() + s.n, s.keys.begin() + pos);
+            std::copy(s.qty.begin() + pos + 1, s.qty.begin() + s.n, s.qty.begin() + pos);
+            s.n--;
+            if (s.n < HOT_LOW) promote(s);
+            return;
+        }
+        if (qty <= 0.0000001) return;
+
+        if (s.n == HOT_CAP) { // demote the worst hot level (or the new one) to the tree
+            if (pos == s.n) { s.cold.assign(key, qty); return; }
+            s.n--;
+            s.cold.assign(s.keys[s.n], s.qty[s.n]);
+        }
+        std::copy_backward(s.keys.begin() + pos, s.keys.begin() + s.n, s.keys.begin() + s.n + 1);
+        std::copy_backward(s.qty.begin() + pos, s.qty.begin() + s.n, s.qty.begin() + s.n + 1);
+        s.keys[pos] = key;
+        s.qty[pos] = qty;
+        s.n++;
+    }
+
+    static void promote(HalfBook& s) {
+        double key, qty;
+        while (s.n < HOT_REFILL && s.cold.pop_front(key, qty)) {
+            s.keys[s.n] = key;
+            s.qty[s.n] = qty;
+            s.n++;
+        }
+    }
+
+    template <class Tag>
+    void load_side(std::vector<Level>& levels) {
+        HalfBook& s = sides[side_index(Tag::side)];
+        for (Level& l : levels) l.price *= Tag::sign;
+        std::sort(levels.begin(), levels.end(), [](const Level& a, const Level& b) { return a.price < b.price; });
+        s.cold.clear();
+        s.n = std::min(levels.size(), HOT_CAP);
+        for (size_t i = 0; i < s.n; i++) { s.keys[i] = levels[i].price; s.qty[i] = levels[i].quantity; }
+        for (size_t i = s.n; i < levels.size(); i++) s.cold.assign(levels[i].price, levels[i].quantity);
+    }
+
+    std::array<HalfBook, 2> sides; // indexed by Side: bids, asks
+};
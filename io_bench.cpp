@@ -0,0 +1,140 @@
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cstring>
+#include <cstdint>
+#include <filesystem>
+#include "file_io.hpp"
+
+// Recording and replay throughput of the file layer: std::fstream (the old
+// recorder/reader), DirectAppender/ReadaheadFile on pwrite/pread, and the same
+// on io_uring. The data mimics compressed recording blocks (40-byte header plus
+// 20-80 KB of incompressible payload). Each run is read back in the same block
+// pattern and checked against a running hash. Point --dir at the disk you
+// record to; on tmpfs O_DIRECT is unavailable and the numbers are memory-bound.
+
+// --- 1. WORKLOAD ---
+struct Workload {
+    std::vector<char> data;       // concatenated blocks, written in order
+    std::vector<size_t> sizes;    // per-block lengths
+};
+
+Workload make_blocks(size_t total) {
+    Workload w;
+    w.data.resize(total);
+    uint64_t x = 0x9E3779B97F4A7C15ull;
+    for (size_t i = 0; i + 8 <= total; i += 8) {
+        x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+        std::memcpy(&w.data[i], &x, 8);
+    }
+    for (size_t off = 0; off < total;) {
+        x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+        size_t n = std::min<size_t>(total - off, 40 + 20000 + x % 60000);
+        w.sizes.push_back(n);
+        off += n;
+    }
+    return w;
+}
+
+uint64_t fnv(const char* p, size_t n, uint64_t h = 1469598103934665603ull) {
+    for (size_t i = 0; i < n; i += 64) h = (h ^ (unsigned char)p[i]) * 1099511628211ull;
+    return h;
+}
+
+// --- 2. BACKENDS ---
+enum class Backend { FSTREAM, SYSCALL, URING };
+
+const char* name(Backend b) {
+    return b == Backend::FSTREAM ? "fstream" : b == Backend::SYSCALL ? "pwrite/pread" : "io_uring";
+}
+
+double write_run(Backend backend, const std::string& path, const Workload& w, bool& direct) {
+    std::filesystem::remove(path);
+    auto start = std::chrono::steady_clock::now();
+    if (backend == Backend::FSTREAM) {
+        // The old recorder: append and flush per block
+        std::ofstream out(path, std::ios::app | std::ios::binary);
+        size_t off = 0;
+        for (size_t n : w.sizes) { out.write(&w.data[off], n); out.flush(); off += n; }
+        direct = false;
+    } else {
+        DirectAppender out;
+        if (!out.open(path, backend == Backend::URING)) return 0;
+        if (backend == Backend::URING && !out.using_uring()) return 0;
+        direct = out.using_direct();
+        size_t off = 0;
+        for (size_t n : w.sizes) { out.append(&w.data[off], n); off += n; }
+        out.close();
+    }
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+double read_run(Backend backend, const std::string& path, const Workload& w, uint64_t& hash) {
+    std::vector<char> buf(128 * 1024);
+    hash = 1469598103934665603ull;
+    auto start = std::chrono::steady_clock::now();
+    if (backend == Backend::FSTREAM) {
+        // The old reader: seek + read per block
+        std::ifstream in(path, std::ios::binary);
+        uint64_t off = 0;
+        for (size_t n : w.sizes) {
+            in.seekg(off);
+            in.read(buf.data(), n);
+            hash = fnv(buf.data(), n, hash);
+            off += n;
+        }
+    } else {
+        ReadaheadFile in;
+        if (!in.open(path, backend == Backend::URING)) return 0;
+        if (backend == Backend::URING && !in.using_uring()) return 0;
+        uint64_t off = 0;
+        for (size_t n : w.sizes) {
+            if (!in.read(off, buf.data(), n)) return 0;
+            hash = fnv(buf.data(), n, hash);
+            off += n;
+        }
+    }
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// --- 3. MAIN ---
+int main(int argc, char** argv) {
+    double gb = 1.0;
+    std::string dir = ".";
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--gb") == 0 && i + 1 < argc) gb = std::atof(argv[++i]);
+        else if (std::strcmp(argv[i], "--dir") == 0 && i + 1 < argc) dir = argv[++i];
+    }
+
+    Workload w = make_blocks((size_t)(gb * (1ull << 30)));
+    uint64_t expect = 1469598103934665603ull;
+    {
+        size_t off = 0;
+        for (size_t n : w.sizes) { expect = fnv(&w.data[off], n, expect); off += n; }
+    }
+    std::string path = dir + "/io_bench.tmp";
+
+    std::cout << "[BENCH] " << gb << " GB in " << w.sizes.size() << " blocks -> " << path << std::endl;
+    std::cout << std::setw(14) << "backend" << std::setw(10) << "direct" << std::setw(12) << "write GB/s"
+              << std::setw(12) << "read GB/s" << "  check" << std::endl;
+
+    for (Backend b : {Backend::FSTREAM, Backend::SYSCALL, Backend::URING}) {
+        bool direct = false;
+        double wsec = write_run(b, path, w, direct);
+        if (wsec == 0) {
+            std::cout << std::setw(14) << name(b) << "  unavailable" << std::endl;
+            continue;
+        }
+        uint64_t hash = 0;
+        double rsec = read_run(b, path, w, hash);
+        double bytes = (double)w.data.size() / (1ull << 30);
+        std::cout << std::setw(14) << name(b) << std::setw(10) << (direct ? "yes" : "no") << std::fixed << std::setprecision(2)
+                  << std::setw(12) << bytes / wsec << std::setw(12) << (rsec > 0 ? bytes / rsec : 0.0)
+                  << "  " << (hash == expect ? "match" : "MISMATCH") << std::endl;
+    }
+    std::filesystem::remove(path);
+    return 0;
+}
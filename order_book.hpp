@@ -0,0 +1,401 @@
+#pragma once
+// Shared by OrderBookEngine (live) and Backtester (replay) so both sides of a
+// recording build bit-identical books and checksums.
+#include <iostream>
+#include <array>
+#include <vector>
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <bit>
+#include <string_view>
+#include <span>
+#include <memory_resource>
+#include <simdjson.h>
+
+// --- 1. DATA STRUCTURES ---
+struct Level {
+    double price;
+    double quantity;
+};
+
+// Order side. The value is also the index of the book side that rests orders of
+// that side (BUY -> bids), so picking a side is an array index, not a branch.
+enum class Side : uint8_t { BUY = 0, SELL = 1 };
+
+constexpr size_t side_index(Side s) { return static_cast<size_t>(s); }
+constexpr Side opposite_side(Side s) { return static_cast<Side>(side_index(s) ^ 1); }
+constexpr double side_sign(Side s) { return 1.0 - 2.0 * double(side_index(s)); } // position delta: BUY +1, SELL -1
+constexpr const char* side_name(Side s) {
+    constexpr const char* names[] = {"BUY", "SELL"};
+    return names[side_index(s)];
+}
+
+// Compile-time book sides: one kernel serves both, with the price ordering and
+// the key sign (sign * price ascends from the best level) as constants.
+struct BidSide {
+    static constexpr Side side = Side::BUY;
+    static constexpr double sign = -1.0;
+    static constexpr bool before(double a, double b) { return a > b; }
+};
+
+struct AskSide {
+    static constexpr Side side = Side::SELL;
+    static constexpr double sign = 1.0;
+    static constexpr bool before(double a, double b) { return a < b; }
+};
+
+// --- 2. HELPER: Fast String Parsing ---
+inline double fast_atof(std::string_view str) {
+    double result;
+    auto [ptr, ec] = std::from_chars(str.data(), str.data() + str.size(), result);
+    if (ec != std::errc()) return 0.0;
+    return result;
+}
+
+// Decodes a depthUpdate side ("b"/"a") into reusable storage for OrderBook::apply_update.
+inline void parse_levels(simdjson::dom::array levels, std::vector<Level>& out) {
+    out.clear();
+    for (simdjson::dom::array level : levels) out.push_back({ fast_atof(level.at(0)), fast_atof(level.at(1)) });
+}
+
+// --- 3. MEMORY OPTIMIZED ORDER BOOK ---
+class OrderBook {
+private:
+    std::array<std::pmr::vector<Level>, 2> sides; // indexed by Side: bids, asks
+    std::pmr::vector<Level> merged; // scratch for apply_update's merge pass
+
+    static constexpr size_t BATCH_MIN = 4; // per side; below this apply_update goes level by level
+
+    template <class Tag> std::pmr::vector<Level>& levels() { return sides[side_index(Tag::side)]; }
+
+    // lower_bound comparator: level `l` sorts ahead of price `val` on this side
+    template <class Tag>
+    struct LevelBefore {
+        bool operator()(const Level& l, double val) const { return Tag::before(l.price, val); }
+    };
+
+    template <class Tag>
+    void update(double price, double qty) {
+        auto& side = levels<Tag>();
+        auto it = std::lower_bound(side.begin(), side.end(), price, LevelBefore<Tag>{});
+
+        if (it != side.end() && it->price == price) {
+            if (qty <= 0.0000001) side.erase(it);
+            else it->quantity = qty;
+        } else if (qty > 0.0000001) {
+            side.insert(it, {price, qty});
+        }
+    }
+
+    // Merges `changes` (sorted best-first, later duplicates win) into one side.
+    // Quantity-only changes are written in place; from the first insert/delete
+    // on, the affected span is merged into scratch and spliced back, so the
+    // levels behind the last change shift once per message at most.
+    template <class Tag>
+    void merge_side(std::span<Level> changes) {
+        auto& side = levels<Tag>();
+        LevelBefore<Tag> before;
+        auto change_before = [](const Level& a, const Level& b) { return Tag::before(a.price, b.price); };
+        if (!std::is_sorted(changes.begin(), changes.end(), change_before)) {
+            // Strictly worst-first (no duplicate prices) reverses without losing order
+            if (std::adjacent_find(changes.begin(), changes.end(),
+                    [](const Level& a, const Level& b) { return !Tag::before(b.price, a.price); }) == changes.end()) {
+                std::reverse(changes.begin(), changes.end());
+            } else {
+                sort_changes<Tag>(changes);
+            }
+        }
+
+        size_t i = 0, j = 0, k = changes.size();
+        auto last_of = [&](size_t j) {
+            while (j + 1 < k && changes[j + 1].price == changes[j].price) j++;
+            return j;
+        };
+
+        for (; j < k; j++) {
+            j = last_of(j);
+            const Level& c = changes[j];
+            i = std::lower_bound(side.begin() + i, side.end(), c.price, before) - side.begin();
+            bool hit = i < side.size() && side[i].price == c.price;
+            bool remove = c.quantity <= 0.0000001;
+            if (hit && !remove) side[i].quantity = c.quantity;
+            else if (hit || !remove) break; // structural change
+        }
+        if (j >= k) return;
+
+        // [i, e) is the span from the first structural change to the last change
+        size_t e = std::lower_bound(side.begin() + i, side.end(), changes[k - 1].price, before) - side.begin();
+        if (e < side.size() && side[e].price == changes[k - 1].price) e++;
+
+        merged.clear();
+        size_t r = i;
+        for (; j < k; j++) {
+            j = last_of(j);
+            const Level& c = changes[j];
+            size_t run = std::lower_bound(side.begin() + r, side.begin() + e, c.price, before) - side.begin();
+            merged.insert(merged.end(), side.begin() + r, side.begin() + run);
+            r = run;
+            if (r < e && side[r].price == c.price) r++;
+            if (c.quantity > 0.0000001) merged.push_back(c);
+        }
+        merged.insert(merged.end(), side.begin() + r, side.begin() + e);
+
+        size_t span = e - i;
+        if (merged.size() > span) side.insert(side.begin() + e, merged.size() - span, Level{0.0, 0.0});
+        else side.erase(side.begin() + i + merged.size(), side.begin() + e);
+        std::copy(merged.begin(), merged.end(), side.begin() + i);
+    }
+
+    // Stable, so the last change to a price stays last. Messages are small and
+    // usually already ordered; insertion sort avoids stable_sort's heap buffer.
+    template <class Tag>
+    static void sort_changes(std::span<Level> changes) {
+        if (changes.size() > 64) {
+            std::stable_sort(changes.begin(), changes.end(),
+                [](const Level& a, const Level& b) { return Tag::before(a.price, b.price); });
+            return;
+        }
+        for (size_t i = 1; i < changes.size(); i++) {
+            Level v = changes[i];
+            size_t p = i;
+            for (; p > 0 && Tag::before(v.price, changes[p - 1].price); p--) changes[p] = changes[p - 1];
+            changes[p] = v;
+        }
+    }
+
+    template <class Tag>
+    void apply_side(std::span<Level> changes) {
+        // A few levels are cheaper one by one than sorting and merging
+        if (changes.size() <= BATCH_MIN) for (const Level& l : changes) update<Tag>(l.price, l.quantity);
+        else merge_side<Tag>(changes);
+    }
+
+    template <class Tag>
+    void load_side(simdjson::dom::array& level_array) {
+        auto& side = levels<Tag>();
+        side.clear();
+        for (simdjson::dom::array level : level_array) side.push_back({ fast_atof(level.at(0)), fast_atof(level.at(1)) });
+        std::sort(side.begin(), side.end(), [](const Level& a, const Level& b) { return Tag::before(a.price, b.price); });
+    }
+
+public:
+    OrderBook(std::pmr::memory_resource* pool)
+        : sides{std::pmr::vector<Level>(pool), std::pmr::vector<Level>(pool)}, merged(pool) {
+        for (auto& side : sides) side.reserve(5000);
+        merged.reserve(5000);
+    }
+
+    // Applies all levels of one depthUpdate: one merge pass per side instead of a
+    // binary search and a memmove per level. Same result as calling update_bid /
+    // update_ask in message order. Reorders the spans.
+    void apply_update(std::span<Level> bid_changes, std::span<Level> ask_changes) {
+        apply_side<BidSide>(bid_changes);
+        apply_side<AskSide>(ask_changes);
+    }
+
+    void update_bid(double price, double qty) { update<BidSide>(price, qty); }
+    void update_ask(double price, double qty) { update<AskSide>(price, qty); }
+
+    void load_snapshot(simdjson::dom::array& bid_array, simdjson::dom::array& ask_array, bool announce = true) {
+        if (announce) std::cout << "[SNAPSHOT] Loading " << bid_array.size() << " bids and " << ask_array.size() << " asks..." << std::endl;
+        load_side<BidSide>(bid_array);
+        load_side<AskSide>(ask_array);
+    }
+
+    double get_imbalance() const {
+        const auto& bids = sides[side_index(Side::BUY)];
+        const auto& asks = sides[side_index(Side::SELL)];
+        if (bids.empty() || asks.empty()) return 0.5;
+        double bid_vol = 0, ask_vol = 0;
+        for(size_t i=0; i<std::min((size_t)5, bids.size()); i++) bid_vol += bids[i].quantity;
+        for(size_t i=0; i<std::min((size_t)5, asks.size()); i++) ask_vol += asks[i].quantity;
+        return bid_vol / (bid_vol + ask_vol);
+    }
+
+    // Best price resting on `side` (BUY -> best bid); 0 when that side is empty.
+    double get_best(Side side) const {
+        const auto& l = sides[side_index(side)];
+        return l.empty() ? 0.0 : l[0].price;
+    }
+    double get_best_bid() const { return get_best(Side::BUY); }
+    double get_best_ask() const { return get_best(Side::SELL); }
+
+    // Applies one depthUpdate and reports what moved inside the observer's window.
+    template <class Observer>
+    void apply_update(std::span<Level> bid_changes, std::span<Level> ask_changes, Observer& observer);
+
+    // Copies up to `n` best levels of `side` into `out`; returns how many.
+    size_t top_levels(Side side, Level* out, size_t n) const {
+        const auto& l = sides[side_index(side)];
+        n = std::min(n, l.size());
+        std::copy_n(l.begin(), n, out);
+        return n;
+    }
+
+    // Raw sorted levels (best first), used to persist and restore book checkpoints.
+    const std::pmr::vector<Level>& bid_levels() const { return sides[side_index(Side::BUY)]; }
+    const std::pmr::vector<Level>& ask_levels() const { return sides[side_index(Side::SELL)]; }
+
+    void restore(const std::vector<Level>& bid_levels, const std::vector<Level>& ask_levels) {
+        sides[side_index(Side::BUY)].assign(bid_levels.begin(), bid_levels.end());
+        sides[side_index(Side::SELL)].assign(ask_levels.begin(), ask_levels.end());
+    }
+
+    // Walks the opposite side for an aggressive order. Returns the quantity that
+    // the visible book can absorb and its total notional (VWAP = notional / filled).
+    struct Sweep { double filled; double notional; };
+    Sweep sweep(Side side, double qty) const {
+        Sweep s{0.0, 0.0};
+        for (const Level& l : sides[side_index(opposite_side(side))]) {
+            double take = std::min(qty - s.filled, l.quantity);
+            s.filled += take;
+            s.notional += take * l.price;
+            if (s.filled >= qty) break;
+        }
+        return s;
+    }
+
+    // FNV-1a over the raw bits of the top `depth` levels of both sides. Prices
+    // parsed from the same decimal strings are bit-identical, so live, replay and
+    // exchange snapshots hash the same when their books agree.
+    uint64_t checksum(size_t depth) const {
+        uint64_t h = 14695981039346656037ull;
+        auto mix = [&h](double v) { h = (h ^ std::bit_cast<uint64_t>(v)) * 1099511628211ull; };
+        const auto& bids = sides[side_index(Side::BUY)];
+        const auto& asks = sides[side_index(Side::SELL)];
+        for (size_t i = 0; i < std::min(depth, bids.size()); i++) { mix(bids[i].price); mix(bids[i].quantity); }
+        mix(0.0); // side separator so a level cannot migrate between sides unnoticed
+        for (size_t i = 0; i < std::min(depth, asks.size()); i++) { mix(asks[i].price); mix(asks[i].quantity); }
+        return h;
+    }
+};
+
+// --- 4. BOOK CHANGE EVENTS ---
+// Lets a strategy skip messages that only churn levels it does not read. An
+// observer is any type with
+//
+//   static constexpr size_t WATCH_DEPTH;           // levels per side it reads
+//   void on_book_change(const BookChange& change); // called only if that window moved
+//
+// and is passed by template parameter, so dispatch is static and inlinable.
+enum BookChangeFlags : uint8_t {
+    TOUCH_PRICE = 1, // best price moved (or the side emptied/refilled)
+    TOP_QTY = 2,     // a quantity changed at a price already in the window
+    TOP_LEVELS = 4,  // a level was added to or removed from the window
+};
+
+struct BookChange {
+    std::array<uint8_t, 2> flags{}; // BookChangeFlags, indexed by Side
+
+    bool any() const { return (flags[0] | flags[1]) != 0; }
+    bool touch_moved() const { return ((flags[0] | flags[1]) & TOUCH_PRICE) != 0; }
+    static BookChange all() { return {{TOUCH_PRICE | TOP_QTY | TOP_LEVELS, TOUCH_PRICE | TOP_QTY | TOP_LEVELS}}; }
+};
+
+// Top `N` levels of both sides, captured before a message and compared after.
+// Exact regardless of how the book applied the message; costs 2 x N level copies.
+template <size_t N>
+class TopWindow {
+public:
+    template <class Book>
+    explicit TopWindow(const Book& book) {
+        for (Side s : {Side::BUY, Side::SELL}) count[side_index(s)] = book.top_levels(s, levels[side_index(s)].data(), N);
+    }
+
+    template <class Book>
+    BookChange diff(const Book& book) const {
+        BookChange c;
+        for (Side s : {Side::BUY, Side::SELL}) {
+            std::array<Level, N> now;
+            size_t n = book.top_levels(s, now.data(), N);
+            const auto& was = levels[side_index(s)];
+            size_t m = count[side_index(s)];
+            uint8_t f = 0;
+            if (n != m) f |= TOP_LEVELS;
+            if ((n == 0) != (m == 0) || (n > 0 && now[0].price != was[0].price)) f |= TOUCH_PRICE;
+            for (size_t i = 0; i < std::min(n, m); i++) {
+                if (now[i].price != was[i].price) f |= TOP_LEVELS;
+                else if (now[i].quantity != was[i].quantity) f |= TOP_QTY;
+            }
+            c.flags[side_index(s)] = f;
+        }
+        return c;
+    }
+
+private:
+    std::array<std::array<Level, N>, 2> levels;
+    std::array<size_t, 2> count;
+};
+
+// Shared by every book's observed apply_update.
+template <class Book, class Observer>
+void apply_observed(Book& book, std::span<Level> bid_changes, std::span<Level> ask_changes, Observer& observer) {
+    TopWindow<Observer::WATCH_DEPTH> before(book);
+    book.apply_update(bid_changes, ask_changes);
+    BookChange change = before.diff(book);
+    if (change.any()) observer.on_book_change(change);
+}
+
+template <class Observer>
+void OrderBook::apply_update(std::span<Level> bid_changes, std::span<Level> ask_changes, Observer& observer) {
+    apply_observed(*this, bid_changes, ask_changes, observer);
+}
+
+// Re-evaluation flag for a strategy reading the top `N` levels. Stays set after
+// the strategy acts (its inputs still call for action once the cooldown ends) and
+// is cleared only by an evaluation that decided to do nothing.
+template <size_t N>
+struct StrategyTrigger {
+    static constexpr size_t WATCH_DEPTH = N;
+    bool dirty = true;
+    long long runs = 0;
+    long long skipped = 0;
+
+    void on_book_change(const BookChange&) { dirty = true; }
+
+    // Call once per message where the strategy could run; true if it must.
+    bool should_run() {
+        if (dirty) { runs++; return true; }
+        skipped++;
+        return false;
+    }
+};
+
+// --- 5. BACKLOG AND CONFLATION ---
+// Tracks messages that arrive with more input already queued behind them. The
+// caller measures `pending` (bytes on the socket live, due records in a paced
+// replay). With `conflate` set, a backlogged message still updates the book but
+// strategy/risk/execution wait for the message that drains the queue, so they
+// run once on the final state of a burst. Catch-up time runs from the first
+// backlogged message to the first one that finds the queue empty.
+struct BacklogMonitor {
+    bool conflate = false;
+    long long backlogged = 0; // messages that had input queued behind them
+    long long conflated = 0;  // ... whose downstream stages were skipped
+    size_t max_pending = 0;
+    long long bursts = 0;
+    long long catchup_total_ns = 0;
+    long long catchup_max_ns = 0;
+
+    // True when the downstream stages should run for this message.
+    bool on_message(size_t pending, long long now_ns) {
+        max_pending = std::max(max_pending, pending);
+        if (pending > 0) {
+            if (!behind) { behind = true; burst_start_ns = now_ns; bursts++; }
+            backlogged++;
+            if (conflate) { conflated++; return false; }
+            return true;
+        }
+        if (behind) {
+            behind = false;
+            catchup_total_ns += now_ns - burst_start_ns;
+            catchup_max_ns = std::max(catchup_max_ns, now_ns - burst_start_ns);
+        }
+        return true;
+    }
+
+private:
+    bool behind = false;
+    long long burst_start_ns = 0;
+};
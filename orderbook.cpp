@@ -13,11 +13,27 @@
 #include <algorithm>
 #include <charconv>
 #include <chrono>
+#include <cerrno>
 #include <cstdio>
+#include <cstring>
 #include <simdjson.h>
 #include <memory_resource>
 #include <array>
 #include <cmath>
+#include <thread>
+#include <optional>
+#include <memory>
+#include "order_book.hpp"
+#include "bounded_book.hpp"
+#include "hybrid_book.hpp"
+#include "book_validator.hpp"
+#include "recording.hpp"
+#include "tls.hpp"
+#include "transport.hpp"
+#include "config.hpp"
+#include "control.hpp"
+#include "telemetry.hpp"
+#include "flight_recorder.hpp"
 
 namespace beast = boost::beast;         
 namespace http = beast::http;           
@@ -26,121 +42,65 @@ namespace net = boost::asio;
 namespace ssl = boost::asio::ssl;       
 using tcp = boost::asio::ip::tcp;       
 
-// --- 1. DATA STRUCTURES ---
-struct Level {
-    double price;
-    double quantity;
-};
-
-// --- 2. HELPER: Fast String Parsing ---
-double fast_atof(std::string_view str) {
-    double result;
-    auto [ptr, ec] = std::from_chars(str.data(), str.data() + str.size(), result);
-    if (ec != std::errc()) return 0.0;
-    return result;
-}
-
-// --- 3. MEMORY OPTIMIZED ORDER BOOK ---
-class OrderBook {
-private:
-    std::pmr::vector<Level> bids; 
-    std::pmr::vector<Level> asks;
-
-public:
-    OrderBook(std::pmr::memory_resource* pool) 
-        : bids(pool), asks(pool) {
-        bids.reserve(5000); 
-        asks.reserve(5000);
-    }
-
-    void update_bid(double price, double qty) {
-        auto it = std::lower_bound(bids.begin(), bids.end(), price, 
-            [](const Level& l, double val) { return l.price > val; });
-
-        if (it != bids.end() && it->price == price) {
-            if (qty <= 0.0000001) bids.erase(it);
-            else it->quantity = qty;
-        } else if (qty > 0.0000001) {
-            bids.insert(it, {price, qty});
-        }
-    }
-
-    void update_ask(double price, double qty) {
-        auto it = std::lower_bound(asks.begin(), asks.end(), price, 
-            [](const Level& l, double val) { return l.price < val; });
-
-        if (it != asks.end() && it->price == price) {
-            if (qty <= 0.0000001) asks.erase(it);
-            else it->quantity = qty;
-        } else if (qty > 0.0000001) {
-            asks.insert(it, {price, qty});
-        }
-    }
-
-    void load_snapshot(simdjson::dom::array& bid_array, simdjson::dom::array& ask_array) {
-        bids.clear();
-        asks.clear();
-        std::cout << "[SNAPSHOT] Loading " << bid_array.size() << " bids and " << ask_array.size() << " asks..." << std::endl;
-        for (simdjson::dom::array level : bid_array) bids.push_back({ fast_atof(level.at(0)), fast_atof(level.at(1)) });
-        for (simdjson::dom::array level : ask_array) asks.push_back({ fast_atof(level.at(0)), fast_atof(level.at(1)) });
-        std::sort(bids.begin(), bids.end(), [](const Level& a, const Level& b) { return a.price > b.price; });
-        std::sort(asks.begin(), asks.end(), [](const Level& a, const Level& b) { return a.price < b.price; });
-    }
-
-    double get_imbalance() {
-        if (bids.empty() || asks.empty()) return 0.5;
-        double bid_vol = 0, ask_vol = 0;
-        for(int i=0; i<std::min((size_t)5, bids.size()); i++) bid_vol += bids[i].quantity;
-        for(int i=0; i<std::min((size_t)5, asks.size()); i++) ask_vol += asks[i].quantity;
-        return bid_vol / (bid_vol + ask_vol);
-    }
-
-    double get_best_bid() { return bids.empty() ? 0.0 : bids[0].price; }
-    double get_best_ask() { return asks.empty() ? 0.0 : asks[0].price; }
-};
-
-// --- 4. RISK MANAGER ---
+// -DHFT_BOOK_DEPTH=64 (or 256) keeps only the top levels in an L1-resident window;
+// -DHFT_HYBRID_BOOK=1 uses the hot-window + B+tree book for very deep books;
+// otherwise the full-depth sorted-vector book.
+#ifndef HFT_BOOK_DEPTH
+#define HFT_BOOK_DEPTH 0
+#endif
+#ifndef HFT_HYBRID_BOOK
+#define HFT_HYBRID_BOOK 0
+#endif
+#if HFT_BOOK_DEPTH > 0
+using LiveBook = BoundedOrderBook<HFT_BOOK_DEPTH>;
+#elif HFT_HYBRID_BOOK
+using LiveBook = HybridOrderBook;
+#else
+using LiveBook = OrderBook;
+#endif
+
+// --- 1. RISK MANAGER ---
+// Limits are passed per check: they can be replaced at runtime (control.hpp).
 class RiskManager {
 private:
-    const double MAX_ORDER_VALUE = 2000.0; 
-    const double MAX_POSITION = 0.01;      
     double current_position = 0.0; 
 
 public:
-    bool check_order(const std::string& side, double price, double quantity) {
+    bool check_order(Side side, double price, double quantity, const HotConfig& limits) {
         double notional_value = price * quantity;
-        if (notional_value > MAX_ORDER_VALUE) {
+        if (notional_value > limits.max_order_value) {
             std::cout << "[RISK REJECT] Value $" << notional_value << " too high." << std::endl;
             return false;
         }
 
-        double projected_position = current_position;
-        if (side == "BUY") projected_position += quantity;
-        else projected_position -= quantity;
+        double projected_position = current_position + side_sign(side) * quantity;
 
-        if (std::abs(projected_position) > MAX_POSITION) {
+        if (std::abs(projected_position) > limits.max_position) {
             std::cout << "[RISK REJECT] Position " << projected_position << " exceeds limit." << std::endl;
             return false;
         }
         return true;
     }
 
-    void update_position(const std::string& side, double quantity) {
-        if (side == "BUY") current_position += quantity;
-        else current_position -= quantity;
+    void update_position(Side side, double quantity) {
+        current_position += side_sign(side) * quantity;
         std::cout << "[RISK] New Position: " << current_position << " BTC" << std::endl;
     }
+
+    double position() const { return current_position; }
 };
 
-// --- 5. EXECUTION GATEWAY ---
+// --- 2. EXECUTION GATEWAY ---
 class ExecutionGateway {
 public:
-    long long send_order(const std::string& side, double price, double quantity) {
+    explicit ExecutionGateway(const std::string& symbol) : symbol(symbol) {}
+
+    long long send_order(Side side, double price, double quantity) {
         auto start = std::chrono::steady_clock::now();
         char buffer[256];
         snprintf(buffer, sizeof(buffer),
-            "{\"symbol\":\"BTCUSD\",\"side\":\"%s\",\"type\":\"LIMIT\",\"quantity\":\"%.4f\",\"price\":\"%.2f\"}", 
-            side.c_str(), quantity, price);
+            "{\"symbol\":\"%s\",\"side\":\"%s\",\"type\":\"LIMIT\",\"quantity\":\"%.4f\",\"price\":\"%.2f\"}", 
+            symbol.c_str(), side_name(side), quantity, price);
         
         // Fixed Busy Wait to avoid compiler warnings
         volatile int check = 0;
@@ -149,125 +109,521 @@ public:
         auto end = std::chrono::steady_clock::now();
         return std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
     }
+
+private:
+    std::string symbol;
+};
+
+// --- 3. HTTP SNAPSHOT CLIENT ---
+// Keeps one HTTPS connection open across snapshot requests. When the server has
+// closed it, the next request reconnects and resumes the cached TLS session.
+class SnapshotClient {
+public:
+    SnapshotClient(net::io_context& ioc, ssl::context& ctx, const EngineConfig& config)
+        : ioc(ioc), ctx(ctx), resolver(ioc), host(config.snapshot_host), port(config.snapshot_port),
+          target(config.snapshot_target()) {}
+
+    std::string fetch() {
+        for (int attempt = 0; attempt < 2; attempt++) {
+            try {
+                if (!stream) connect();
+                http::request<http::string_body> req{http::verb::get, target, 11};
+                req.set(http::field::host, host);
+                req.set(http::field::user_agent, "HFT-Client/1.0");
+                req.keep_alive(true);
+                http::write(*stream, req);
+                http::response<http::string_body> res;
+                http::read(*stream, buffer, res);
+                if (!res.keep_alive()) close();
+                return std::move(res.body());
+            } catch (std::exception const& e) {
+                // A kept-alive connection the server dropped fails on first use; retry once fresh
+                close();
+                if (attempt == 1) std::cerr << "Snapshot Error: " << e.what() << std::endl;
+            }
+        }
+        return {};
+    }
+
+private:
+    void connect() {
+        stream.emplace(ioc, ctx);
+        net::connect(beast::get_lowest_layer(*stream), resolver.resolve(host, port));
+        beast::get_lowest_layer(*stream).set_option(tcp::no_delay(true));
+        tls_handshake(*stream, host, "snapshot");
+    }
+
+    void close() {
+        if (!stream) return;
+        tls_abandon(stream->native_handle());
+        beast::error_code ec;
+        beast::get_lowest_layer(*stream).close(ec);
+        stream.reset();
+        buffer.clear();
+    }
+
+    net::io_context& ioc;
+    ssl::context& ctx;
+    tcp::resolver resolver;
+    std::string host, port, target;
+    std::optional<beast::ssl_stream<tcp::socket>> stream;
+    beast::flat_buffer buffer;
 };
 
-// --- 6. HTTP SNAPSHOT CLIENT ---
-void fetch_snapshot(net::io_context& ioc, ssl::context& ctx, OrderBook& book) {
+// Loads a fresh snapshot into `book` and returns its lastUpdateId (0 on failure).
+// The raw body is recorded so replays resync at the same point.
+template <class Book>
+long long fetch_snapshot(SnapshotClient& client, Book& book, MarketRecorder* recorder = nullptr) {
+    std::string body = client.fetch();
+    if (body.empty()) return 0;
     try {
-        tcp::resolver resolver{ioc};
-        beast::ssl_stream<tcp::socket> stream{ioc, ctx};
-        auto const results = resolver.resolve("api.binance.us", "443");
-        net::connect(stream.next_layer(), results.begin(), results.end());
-        stream.handshake(ssl::stream_base::client);
-        http::request<http::string_body> req{http::verb::get, "/api/v3/depth?symbol=BTCUSD&limit=1000", 11};
-        req.set(http::field::host, "api.binance.us");
-        req.set(http::field::user_agent, "HFT-Client/1.0");
-        http::write(stream, req);
-        beast::flat_buffer buffer;
-        http::response<http::string_body> res;
-        http::read(stream, buffer, res);
         simdjson::dom::parser parser;
-        simdjson::dom::element doc = parser.parse(res.body());
+        simdjson::dom::element doc = parser.parse(body);
         simdjson::dom::array bids = doc["bids"]; 
         simdjson::dom::array asks = doc["asks"]; 
         book.load_snapshot(bids, asks);
-        beast::error_code ec;
-        stream.shutdown(ec);
+        if (recorder && recorder->is_open()) {
+            auto recv_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+            recorder->record(recv_ns, body);
+        }
+        return int64_t(doc["lastUpdateId"]);
     } catch (std::exception const& e) {
         std::cerr << "Snapshot Error: " << e.what() << std::endl;
+        return 0;
+    }
+}
+
+// --- 4. SNAPSHOT VERIFIER ---
+// Pulls a REST snapshot every verify_interval_s off the hot thread and hands its top-K
+// checksum to the validator, which matches it against the live book's history.
+void run_snapshot_verifier(std::stop_token stop, ssl::context& ctx, const EngineConfig& config, BookValidator& validator) {
+    const std::chrono::seconds interval(config.verify_interval_s);
+    net::io_context ioc;
+    SnapshotClient client(ioc, ctx, config);
+    simdjson::dom::parser parser;
+    OrderBook scratch(std::pmr::new_delete_resource());
+    auto next = std::chrono::steady_clock::now() + interval;
+
+    while (!stop.stop_requested()) {
+        if (std::chrono::steady_clock::now() < next) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            continue;
+        }
+        next += interval;
+
+        std::string body = client.fetch();
+        if (body.empty()) continue;
+        try {
+            simdjson::dom::element doc = parser.parse(body);
+            simdjson::dom::array bids = doc["bids"];
+            simdjson::dom::array asks = doc["asks"];
+            scratch.load_snapshot(bids, asks, false);
+            validator.offer({int64_t(doc["lastUpdateId"]), scratch.checksum(BookValidator::DEPTH)});
+        } catch (std::exception const& e) {
+            std::cerr << "[VALIDATOR] Bad snapshot: " << e.what() << std::endl;
+        }
     }
 }
 
-// --- 7. MAIN ENGINE ---
-int main() {
+// --- 5. MAIN ENGINE ---
+int main(int argc, char** argv) {
+    // --codec none writes the plain text log; lz4 (default) / zstd write block-compressed files
+    Codec codec = Codec::LZ4;
+    std::string record_path;
+    BacklogMonitor backlog;
+    // --transport packet --iface <if> --port <n>: UDP market data from a packet-mmap ring
+    // --transport replay --input <file>: a recording through the same loop (not re-recorded unless --record)
+    std::string transport = "asio";
+    std::string replay_path;
+    std::string iface;
+    uint16_t udp_port = 9000;
+    SocketTuning tuning; // market-data TCP socket (asio transport)
+    std::string config_path; // --config <file.json>: see config.hpp; built-in defaults otherwise
+    std::string control_path; // --control <socket>: live strategy/risk updates, see control.hpp
+    uint16_t metrics_port = 0; // --metrics-port <n>: Prometheus endpoint on 127.0.0.1 (0 = off)
+    std::string metrics_name;  // --metrics-name <name>: shared page /dev/shm/<name> (default hft_metrics.<pid>)
+    // Flight recorder (flight_recorder.hpp): ring size (power of two, >= 1024), dump directory, slow-message trigger (0 = off)
+    size_t trace_records = 65536;
+    std::string trace_dir = ".";
+    long long trace_threshold_us = 0;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--config") == 0 && i + 1 < argc) config_path = argv[++i];
+        else if (std::strcmp(argv[i], "--control") == 0 && i + 1 < argc) control_path = argv[++i];
+        else if (std::strcmp(argv[i], "--metrics-port") == 0 && i + 1 < argc) metrics_port = (uint16_t)std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--metrics-name") == 0 && i + 1 < argc) metrics_name = argv[++i];
+        else if (std::strcmp(argv[i], "--trace-records") == 0 && i + 1 < argc) trace_records = (size_t)std::max(0LL, std::atoll(argv[++i]));
+        else if (std::strcmp(argv[i], "--trace-dir") == 0 && i + 1 < argc) trace_dir = argv[++i];
+        else if (std::strcmp(argv[i], "--trace-threshold-us") == 0 && i + 1 < argc) trace_threshold_us = std::max(0LL, std::atoll(argv[++i]));
+        else if (std::strcmp(argv[i], "--codec") == 0 && i + 1 < argc) codec = parse_codec(argv[++i]);
+        else if (std::strcmp(argv[i], "--record") == 0 && i + 1 < argc) record_path = argv[++i];
+        else if (std::strcmp(argv[i], "--conflate") == 0) backlog.conflate = true;
+        else if (std::strcmp(argv[i], "--transport") == 0 && i + 1 < argc) transport = argv[++i];
+        else if (std::strcmp(argv[i], "--input") == 0 && i + 1 < argc) replay_path = argv[++i];
+        else if (std::strcmp(argv[i], "--iface") == 0 && i + 1 < argc) iface = argv[++i];
+        else if (std::strcmp(argv[i], "--port") == 0 && i + 1 < argc) udp_port = (uint16_t)std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--no-nodelay") == 0) tuning.nodelay = false;
+        else if (std::strcmp(argv[i], "--quickack") == 0) tuning.quickack = true;
+        else if (std::strcmp(argv[i], "--busy-poll") == 0 && i + 1 < argc) tuning.busy_poll_us = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--rcvbuf") == 0 && i + 1 < argc) tuning.rcvbuf = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--timestamps") == 0 && i + 1 < argc) tuning.timestamps = parse_rx_timestamps(argv[++i]);
+        else if (std::strcmp(argv[i], "--hw-iface") == 0 && i + 1 < argc) tuning.hw_iface = argv[++i];
+    }
+    bool record = transport != "replay" || !record_path.empty();
+    if (record_path.empty()) record_path = codec == Codec::NONE ? "market_data.log" : "market_data.rec";
+
+    EngineConfig loaded;
+    if (!config_path.empty()) {
+        if (!load_config(config_path, loaded)) return 1;
+        std::cout << "[CONFIG] Loaded " << config_path << std::endl;
+    }
+    const EngineConfig& config = loaded; // frozen from here on
+
+    // Dump signals go to the flight recorder's thread only: block them before any other thread starts
+    FlightRecorder::block_signals();
+    FlightRecorder flight(trace_records, trace_dir, trace_threshold_us * 1000);
+    std::jthread flight_thread([&](std::stop_token stop) { flight.run(stop); });
+#if HFT_CONFIG_PROFILE
+    // Strategy and risk values compiled in from the profile; the file's copies are ignored
+    constexpr const HotConfig& hot = BAKED_HOT;
+    if (!config_path.empty() && !(config.hot == BAKED_HOT)) {
+        std::cerr << "[CONFIG] strategy/risk values differ from the compiled-in profile; using the profile" << std::endl;
+    }
+    if (!control_path.empty()) {
+        std::cerr << "[CONTROL] Strategy/risk values are compiled in (HFT_CONFIG_PROFILE); --control ignored" << std::endl;
+    }
+#else
+    // Strategy and risk values: published by the control thread, read once per message
+    LiveConfig live(config.hot);
+    ControlChannel control;
+    std::jthread control_thread;
+    if (!control_path.empty()) {
+        if (!control.open(control_path)) {
+            std::cerr << "Error: cannot listen on control socket " << control_path << ": " << std::strerror(errno) << std::endl;
+            return 1;
+        }
+        control_thread = std::jthread([&](std::stop_token stop) { control.run(stop, live); });
+        std::cout << "[CONTROL] Accepting parameter updates on " << control_path << std::endl;
+    }
+#endif
+
     try {
-        alignas(std::max_align_t) std::array<std::byte, 1024 * 1024> memory_buffer; 
-        std::pmr::monotonic_buffer_resource pool{memory_buffer.data(), memory_buffer.size()};
+        // Zero-filled on allocation, so its pages are faulted in before the first update
+        auto memory_buffer = std::make_unique<std::byte[]>(config.arena_bytes);
+        std::pmr::monotonic_buffer_resource pool{memory_buffer.get(), config.arena_bytes};
+        CountingResource arena{&pool}; // arena usage for telemetry
+
+        // Metrics page in shared memory, written by the hot thread below
+        Telemetry telemetry(metrics_name);
+        telemetry.set(metric::ARENA_BYTES, (double)config.arena_bytes);
+        MetricsServer metrics_server;
+        std::jthread metrics_thread;
+        if (metrics_port) {
+            if (!metrics_server.open(metrics_port)) {
+                std::cerr << "Error: cannot listen on 127.0.0.1:" << metrics_port << std::endl;
+                return 1;
+            }
+            metrics_thread = std::jthread([&](std::stop_token stop) { metrics_server.run(stop, telemetry.read()); });
+            std::cout << "[METRICS] Serving http://127.0.0.1:" << metrics_port << "/metrics"
+                      << (telemetry.is_shared() ? " (page: /dev/shm" + telemetry.name() + ")" : "") << std::endl;
+        }
 
         net::io_context ioc;
-        ssl::context ctx{ssl::context::tlsv12_client};
+        ssl::context ctx{ssl::context::tls_client};
         ctx.set_default_verify_paths();
+        configure_tls(ctx);
+        SnapshotClient snapshots(ioc, ctx, config);
         
-        OrderBook book(&pool);
-        ExecutionGateway gateway;
+        LiveBook book(&arena);
+        ExecutionGateway gateway(config.symbol);
         RiskManager risk;
+        BookValidator validator;
 
         // --- DATA RECORDER SETUP ---
-        std::ofstream log_file("market_data.log", std::ios::app);
-        if (!log_file.is_open()) std::cerr << "[WARNING] Failed to open log file!" << std::endl;
-        else std::cout << "[SYSTEM] Recording Market Data to market_data.log..." << std::endl;
-
-        std::cout << "[SYSTEM] Fetching HTTP Snapshot..." << std::endl;
-        fetch_snapshot(ioc, ctx, book);
-        std::cout << "[SYSTEM] Snapshot Loaded. Connecting to Stream..." << std::endl;
-
-        tcp::resolver resolver{ioc};
-        auto const results = resolver.resolve("stream.binance.us", "9443");
-        websocket::stream<beast::ssl_stream<tcp::socket>> ws{ioc, ctx};
-        net::connect(beast::get_lowest_layer(ws), results);
-        ws.next_layer().handshake(ssl::stream_base::client);
-        ws.set_option(websocket::stream_base::decorator([](websocket::request_type& req) {req.set(http::field::user_agent, "HFT-Client/1.0");}));
-        ws.handshake("stream.binance.us:9443", "/ws/btcusd@depth");
-        
+        MarketRecorder recorder;
+        if (record) {
+            if (!recorder.open(record_path, codec)) std::cerr << "[WARNING] Failed to open log file!" << std::endl;
+            else std::cout << "[SYSTEM] Recording Market Data to " << record_path << "..." << std::endl;
+        }
+
         simdjson::dom::parser parser;
-        if (parser.allocate(64000) != simdjson::SUCCESS) std::cerr << "Memory allocation failure" << std::endl;
-        beast::flat_buffer buffer;
-        
+        if (!preallocate_parser(parser)) std::cerr << "Memory allocation failure" << std::endl;
+        std::vector<Level> bid_changes, ask_changes; // reused per message by apply_update
+        bid_changes.reserve(1000);
+        ask_changes.reserve(1000);
+
         int cooldown = 0;
+        StrategyTrigger<5> trigger; // top 5 levels: get_imbalance() and the touch
+        RxLatency kernel_latency; // kernel receive -> our read returns: wake-up, TLS, Beast framing
+        RxLatency parse_latency;  // read returns -> levels parsed: our own code
+        RxLatency update_latency; // read returns -> book updated
         int count = 0;
-        double trade_qty = 0.002; 
-
-        while(true) {
-            ws.read(buffer);
-            auto start_time = std::chrono::steady_clock::now();
-            auto data_str = beast::buffers_to_string(buffer.data());
-
-            // --- RECORDING ---
-            log_file << data_str << "\n";
-            
-            simdjson::dom::element doc = parser.parse(data_str);
-            simdjson::dom::array bids = doc["b"];
-            simdjson::dom::array asks = doc["a"];
-
-            for (simdjson::dom::array level : bids) book.update_bid(fast_atof(level.at(0)), fast_atof(level.at(1)));
-            for (simdjson::dom::array level : asks) book.update_ask(fast_atof(level.at(0)), fast_atof(level.at(1)));
-
-            auto end_time = std::chrono::steady_clock::now();
-            auto latency = std::chrono::duration_cast<std::chrono::nanoseconds>(end_time - start_time).count();
-            buffer.consume(buffer.size());
-
-            // Strategy
-            if (cooldown > 0) cooldown--;
-            if (cooldown == 0) {
-                double imbalance = book.get_imbalance();
-
-                if (book.get_best_ask() > book.get_best_bid()) {
-                    std::string signal_side = "";
-                    double signal_price = 0.0;
-
-                    if (imbalance > 0.8) {
-                        signal_side = "BUY";
-                        signal_price = book.get_best_bid();
-                    } else if (imbalance < 0.2) {
-                        signal_side = "SELL";
-                        signal_price = book.get_best_ask();
+
+        // The hot loop, instantiated once per transport
+        auto run = [&](auto& feed) {
+            constexpr bool in_band = std::remove_reference_t<decltype(feed)>::IN_BAND_SNAPSHOTS;
+            // Without a valid snapshot, updates are dropped and the strategy does not run.
+            // In-band feeds wait for their next snapshot; REST snapshots are retried with backoff.
+            bool awaiting_snapshot = in_band || validator.get_last_update_id() == 0;
+            auto retry_at = std::chrono::steady_clock::time_point{};
+            std::chrono::milliseconds backoff{100};
+            auto try_snapshot = [&] {
+                long long snapshot_id = fetch_snapshot(snapshots, book, &recorder);
+                if (snapshot_id == 0) {
+                    std::cerr << "[SYSTEM] Snapshot failed, book held invalid. Retrying in " << backoff.count() << " ms" << std::endl;
+                    retry_at = std::chrono::steady_clock::now() + backoff;
+                    backoff = std::min(backoff * 2, std::chrono::milliseconds(10000));
+                    return false;
+                }
+                if (validator.get_last_update_id() == 0) validator.start(snapshot_id);
+                else validator.on_resync(snapshot_id);
+                backoff = std::chrono::milliseconds(100);
+                return true;
+            };
+            auto resync = [&] {
+                awaiting_snapshot = in_band || !try_snapshot();
+                trigger.dirty = true;
+            };
+
+            while(true) {
+                long long recv_ns = 0;
+                std::string_view data_str = feed.read(recv_ns);
+                if (flight.shutdown_requested()) break; // SIGINT / SIGTERM (the asio feed notices on its next message): unwind so everything closes cleanly
+                if constexpr (requires { feed.exhausted(); }) {
+                    if (feed.exhausted()) break;
+                }
+                long long read_ns = wall_ns();
+                auto start_time = std::chrono::steady_clock::now();
+                telemetry.add(metric::MESSAGES);
+                telemetry.add(metric::BYTES, data_str.size());
+                TraceRecord& trace = flight.begin(recv_ns, read_ns, data_str.size());
+
+                // --- RECORDING ---
+                // "<recv_ns> <json>": receive time lets the Backtester pace replays
+                recorder.record(recv_ns, data_str);
+
+                if constexpr (!in_band) {
+                    if (awaiting_snapshot && std::chrono::steady_clock::now() >= retry_at) {
+                        awaiting_snapshot = !try_snapshot();
+                        trace.apply_ns = (int32_t)(wall_ns() - read_ns); // the REST fetch
+                    }
+                    if (awaiting_snapshot) {
+                        trace.outcome = TraceOutcome::DROPPED;
+                        flight.finish(trace);
+                        continue;
+                    }
+                }
+
+                // In place when the feed's buffer is padded; a copy into the parser otherwise
+                simdjson::dom::element doc = parser.parse(data_str.data(), data_str.size(), !feed.padded());
+                if constexpr (in_band) {
+                    int64_t snapshot_id;
+                    if (doc["lastUpdateId"].get(snapshot_id) == simdjson::SUCCESS) {
+                        if (!awaiting_snapshot) { // periodic repeat; the book is already in sync
+                            trace.outcome = TraceOutcome::STALE;
+                            trace.update_id = snapshot_id;
+                            flight.finish(trace);
+                            continue;
+                        }
+                        simdjson::dom::array bids = doc["bids"];
+                        simdjson::dom::array asks = doc["asks"];
+                        book.load_snapshot(bids, asks);
+                        if (validator.get_last_update_id() == 0) validator.start(snapshot_id);
+                        else validator.on_resync(snapshot_id);
+                        awaiting_snapshot = false;
+                        trigger.dirty = true;
+                        std::cout << "[SYSTEM] In-band snapshot at u=" << snapshot_id << std::endl;
+                        trace.outcome = TraceOutcome::SNAPSHOT;
+                        trace.update_id = snapshot_id;
+                        trace.apply_ns = (int32_t)(wall_ns() - read_ns);
+                        flight.finish(trace);
+                        continue;
                     }
+                    if (awaiting_snapshot) {
+                        trace.outcome = TraceOutcome::DROPPED;
+                        flight.finish(trace);
+                        continue;
+                    }
+                }
+                int64_t first_id = doc["U"];
+                int64_t last_id = doc["u"];
+                trace.update_id = last_id;
+                if (!validator.should_apply(last_id)) { // already in the snapshot
+                    trace.outcome = TraceOutcome::STALE;
+                    flight.finish(trace);
+                    continue;
+                }
 
-                    if (!signal_side.empty()) {
-                        if (risk.check_order(signal_side, signal_price, trade_qty)) {
-                            long long exec_time = gateway.send_order(signal_side, signal_price, trade_qty);
-                            risk.update_position(signal_side, trade_qty);
-                            std::cout << "[EXEC] " << signal_side << " | Latency: " << latency << "ns" << std::endl;
-                            cooldown = 2000;
-                        } else {
-                            cooldown = 5000; 
+                simdjson::dom::array bids = doc["b"];
+                simdjson::dom::array asks = doc["a"];
+
+                parse_levels(bids, bid_changes);
+                parse_levels(asks, ask_changes);
+                long long parsed_ns = wall_ns();
+                kernel_latency.add(recv_ns, read_ns);
+                parse_latency.add(read_ns, parsed_ns);
+                telemetry.observe(metric::KERNEL_TO_READ, read_ns - recv_ns);
+                telemetry.observe(metric::READ_TO_PARSE, parsed_ns - read_ns);
+                trace.parse_ns = (int32_t)(parsed_ns - read_ns);
+                trace.levels = (uint16_t)std::min<size_t>(bid_changes.size() + ask_changes.size(), UINT16_MAX);
+                book.apply_update(bid_changes, ask_changes, trigger);
+                trace.apply_ns = (int32_t)(wall_ns() - read_ns);
+
+                auto end_time = std::chrono::steady_clock::now();
+                auto latency = std::chrono::duration_cast<std::chrono::nanoseconds>(end_time - start_time).count();
+                update_latency.add(0, latency);
+                telemetry.observe(metric::UPDATE_TO_BOOK, latency);
+
+                // --- VALIDATION ---
+                auto check = validator.on_update(book, first_id, last_id);
+                if (check == BookValidator::Result::VERIFIED) {
+                    // Exchange-verified checkpoint; the Backtester re-checks its book against it
+                    const Checkpoint& c = validator.get_last_verified();
+                    char chk[96];
+                    int n = snprintf(chk, sizeof(chk), "{\"chk\":{\"u\":%lld,\"crc\":%llu}}", c.update_id, (unsigned long long)c.checksum);
+                    recorder.record(recv_ns, std::string_view(chk, n));
+                } else if (check != BookValidator::Result::OK) {
+                    std::cout << "[VALIDATOR] Book invalid at u=" << last_id << " (gaps " << validator.gaps
+                              << ", crossed " << validator.crossed << ", diverged " << validator.divergences << "). Resyncing..." << std::endl;
+                    trace.outcome = TraceOutcome::RESYNC;
+                    resync();
+                    trace.apply_ns = (int32_t)(wall_ns() - read_ns);
+                    flight.finish(trace);
+                    continue;
+                }
+#if HFT_BOOK_DEPTH > 0
+                if (book.needs_resync()) {
+                    std::cout << "[BOOK] Window drained at u=" << last_id << " (" << book.out_of_window
+                              << " out-of-window updates). Resyncing..." << std::endl;
+                    trace.outcome = TraceOutcome::RESYNC;
+                    resync();
+                    trace.apply_ns = (int32_t)(wall_ns() - read_ns);
+                    flight.finish(trace);
+                    continue;
+                }
+#endif
+
+                // Backlog: bytes already queued on the transport behind this message
+                size_t pending = feed.queued();
+                trace.pending = (uint32_t)std::min<size_t>(pending, UINT32_MAX);
+                bool run_stages = backlog.on_message(pending, std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    end_time.time_since_epoch()).count());
+
+#if !HFT_CONFIG_PROFILE
+                const HotConfig& hot = live.read(); // a published update takes effect here
+#endif
+
+                // Strategy: runs only when its top-5 window moved since it last did nothing
+                if (cooldown > 0) cooldown--;
+                trace.outcome = !run_stages ? TraceOutcome::CONFLATED : cooldown ? TraceOutcome::COOLDOWN : TraceOutcome::UNCHANGED;
+                if (run_stages && cooldown == 0 && trigger.should_run()) {
+                    trigger.dirty = false;
+                    trace.outcome = TraceOutcome::NO_SIGNAL;
+                    double imbalance = book.get_imbalance();
+
+                    if (book.get_best_ask() > book.get_best_bid()) {
+                        bool signal = imbalance > hot.buy_threshold || imbalance < hot.sell_threshold;
+                        Side signal_side = imbalance > hot.buy_threshold ? Side::BUY : Side::SELL;
+                        // Passive entry: join our own side of the book
+                        double signal_price = book.get_best(signal_side);
+
+                        if (signal) {
+                            trigger.dirty = true; // acted: re-evaluate once the cooldown ends
+                            if (signal_side == Side::SELL) trace.flags |= TraceRecord::SELL;
+                            trace.decide_ns = (int32_t)(wall_ns() - read_ns);
+                            if (risk.check_order(signal_side, signal_price, hot.trade_qty, hot)) {
+                                long long exec_time = gateway.send_order(signal_side, signal_price, hot.trade_qty);
+                                trace.outcome = TraceOutcome::ORDER;
+                                trace.send_ns = (int32_t)(wall_ns() - read_ns);
+                                risk.update_position(signal_side, hot.trade_qty);
+                                telemetry.observe(metric::ORDER_SEND, exec_time);
+                                telemetry.add(metric::ORDERS_SENT);
+                                std::cout << "[EXEC] " << side_name(signal_side) << " | Latency: " << latency << "ns" << std::endl;
+                                cooldown = hot.cooldown_after_fill;
+                            } else {
+                                trace.outcome = TraceOutcome::REJECT;
+                                telemetry.add(metric::RISK_REJECTS);
+                                cooldown = hot.cooldown_after_reject;
+                            }
                         }
                     }
+                    if (!trace.decide_ns) trace.decide_ns = (int32_t)(wall_ns() - read_ns);
                 }
+                flight.finish(trace);
+
+                // --- TELEMETRY ---
+                // Mirrors of counters the stages keep themselves
+                telemetry.set(metric::STRATEGY_RUNS, trigger.runs);
+                telemetry.set(metric::STRATEGY_SKIPPED, trigger.skipped);
+                telemetry.set(metric::BOOK_VERIFIED, validator.verified);
+                telemetry.set(metric::BOOK_GAPS, validator.gaps);
+                telemetry.set(metric::BOOK_CROSSED, validator.crossed);
+                telemetry.set(metric::BOOK_DIVERGENCES, validator.divergences);
+                telemetry.set(metric::RESYNCS, validator.resyncs);
+                telemetry.set(metric::BACKLOGGED, backlog.backlogged);
+                telemetry.set(metric::CONFLATED, backlog.conflated);
+                telemetry.set(metric::BACKLOG_BURSTS, backlog.bursts);
+                telemetry.set(metric::RECORDS_DROPPED, recorder.dropped);
+                telemetry.set(metric::BACKLOG_BYTES, (double)pending);
+                telemetry.set(metric::BACKLOG_MAX_BYTES, (double)backlog.max_pending);
+                telemetry.set(metric::CATCHUP_MAX_SECONDS, backlog.catchup_max_ns * 1e-9);
+                telemetry.set(metric::ARENA_USED_BYTES, (double)arena.allocated);
+                telemetry.set(metric::POSITION, risk.position());
+                telemetry.set(metric::BEST_BID, book.get_best_bid());
+                telemetry.set(metric::BEST_ASK, book.get_best_ask());
+                telemetry.set(metric::LAST_UPDATE_ID, (double)last_id);
+
+                count++;
+                if (count % 2000 == 0) {
+                    std::cout << "Processed " << count << " updates. [book verified " << validator.verified
+                              << ", resyncs " << validator.resyncs << ", locked " << validator.locked
+                              << "] [strategy runs " << trigger.runs << ", skipped " << trigger.skipped
+                              << "] [backlog max " << backlog.max_pending << " B, " << backlog.backlogged << " behind, "
+                              << backlog.conflated << " conflated, catch-up max " << backlog.catchup_max_ns / 1000 << " us]"
+                              << " [kernel->read mean " << kernel_latency.mean_ns() << " ns, max " << kernel_latency.max_ns
+                              << " ns] [read->parse mean " << parse_latency.mean_ns() << " ns, max " << parse_latency.max_ns << " ns]" << std::endl;
+                    if constexpr (requires { feed.decode; }) {
+                        std::cout << "  [tls+ws decode mean " << feed.decode.mean_ns() << " ns, max " << feed.decode.max_ns << " ns]" << std::endl;
+                    }
+                }
+            }
+        };
+
+        if (transport == "packet") {
+#if defined(__linux__)
+            PacketRingFeed feed(iface, udp_port, &flight.shutdown_flag());
+            std::cout << "[SYSTEM] Reading UDP port " << udp_port << " from the packet ring on " << iface
+                      << ". Waiting for an in-band snapshot..." << std::endl;
+            run(feed);
+#else
+            std::cerr << "Error: --transport packet needs Linux (packet-mmap)" << std::endl;
+            return 1;
+#endif
+        } else if (transport == "replay") {
+            ReplayFeed feed(replay_path);
+            std::cout << "[SYSTEM] Replaying " << replay_path << " through the live loop..." << std::endl;
+            auto start = std::chrono::steady_clock::now();
+            run(feed);
+            double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            std::cout << "[REPLAY] " << feed.messages << " messages in " << (long long)(secs * 1000) << " ms ("
+                      << (long long)(feed.messages / std::max(secs, 1e-9)) << " msg/s) [read->parse mean "
+                      << parse_latency.mean_ns() << " ns] [read->book mean " << update_latency.mean_ns()
+                      << " ns] [strategy runs " << trigger.runs << "]" << std::endl;
+        } else {
+            std::cout << "[SYSTEM] Fetching HTTP Snapshot..." << std::endl;
+            long long snapshot_id = fetch_snapshot(snapshots, book, &recorder);
+            if (snapshot_id) {
+                validator.start(snapshot_id);
+                std::cout << "[SYSTEM] Snapshot Loaded. Connecting to Stream..." << std::endl;
+            } else {
+                std::cerr << "[SYSTEM] Initial snapshot failed; updates are dropped until a retry succeeds" << std::endl;
             }
-            
-            count++;
-            if (count % 2000 == 0) std::cout << "Processed " << count << " updates." << std::endl;
+
+            AsioFeed feed(ioc, ctx, tuning);
+            feed.connect(config.stream_host, config.stream_port, config.stream_target());
+            // REST snapshot checkpoints only describe the exchange's own stream
+            std::jthread verifier(run_snapshot_verifier, std::ref(ctx), std::cref(config), std::ref(validator));
+            run(feed);
         }
 
     } catch (std::exception const& e) {
@@ -275,4 +631,4 @@ int main() {
         return 1;
     }
     return 0;
-}
\ No newline at end of file
+}
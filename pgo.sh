@@ -0,0 +1,48 @@
+#!/usr/bin/env bash
+# Profile-guided + link-time optimized build of OrderBookEngine and Backtester.
+#
+#   1. instrumented build        (HFT_PGO=GENERATE)
+#   2. training run on a recorded log: the Backtester replay, then the engine's
+#      own hot loop via --transport replay (GCC keeps profiles per source file,
+#      so the Backtester alone would leave orderbook.cpp untrained)
+#   3. optimized rebuild         (HFT_PGO=USE, HFT_LTO=ON) in the same directory
+#
+# Usage: ./pgo.sh [recording] [build-dir] [extra cmake args...]
+#   recording  a .rec log of the market you trade; without one FlowGenerator
+#              writes a synthetic 2M-message log
+#   build-dir  defaults to build-pgo
+# e.g. ./pgo.sh market_data.rec build-pgo -DHFT_ARCH=x86-64-v3
+set -euo pipefail
+
+SRC=$(cd "$(dirname "$0")" && pwd)
+RECORDING=${1:-}
+BUILD=${2:-build-pgo}
+shift $(( $# < 2 ? $# : 2 ))
+mkdir -p "$BUILD"
+BUILD=$(cd "$BUILD" && pwd)
+PROFILES="$BUILD/pgo"
+JOBS=$(nproc 2>/dev/null || sysctl -n hw.ncpu)
+
+echo "[PGO] 1/3 Instrumented build in $BUILD"
+rm -rf "$PROFILES"
+cmake -S "$SRC" -B "$BUILD" -DCMAKE_BUILD_TYPE=Release -DHFT_PGO=GENERATE -DHFT_PGO_DIR="$PROFILES" -DHFT_LTO=ON "$@"
+cmake --build "$BUILD" -j"$JOBS" --target OrderBookEngine Backtester FlowGenerator
+
+if [ -z "$RECORDING" ]; then
+    RECORDING="$BUILD/pgo_training.rec"
+    "$BUILD/FlowGenerator" --messages 2000000 --out "$RECORDING"
+fi
+
+echo "[PGO] 2/3 Training on $RECORDING"
+TRAIN_DIR=$(mktemp -d)
+trap 'rm -rf "$TRAIN_DIR"' EXIT
+RECORDING=$(cd "$(dirname "$RECORDING")" && pwd)/$(basename "$RECORDING")
+cd "$TRAIN_DIR" # keep reports and dumps out of the caller's directory
+"$BUILD/Backtester" --input "$RECORDING" | tail -n 5
+"$BUILD/OrderBookEngine" --transport replay --input "$RECORDING" --trace-dir "$TRAIN_DIR" | grep '^\[REPLAY\]'
+cd - > /dev/null
+
+echo "[PGO] 3/3 Optimized rebuild"
+cmake -S "$SRC" -B "$BUILD" -DHFT_PGO=USE
+cmake --build "$BUILD" -j"$JOBS"
+echo "[PGO] Done: $BUILD/OrderBookEngine, $BUILD/Backtester"
@@ -0,0 +1,594 @@
+#pragma once
+// Market-data recording format shared by the recorder (OrderBookEngine) and the
+// replay reader (Backtester).
+//
+// Plain mode appends "<recv_ns> <json>\n" lines to a text file. Block mode packs
+// the same lines into ~256 KB blocks, compresses each with LZ4 (fast, for live
+// recording) or zstd (dense, for archives) and prefixes it with a BlockHeader.
+// Live capture never waits for the writer: it uses a fast zstd level and drops
+// records if every block buffer is still queued. Its blocks are also sealed by
+// age and the file's tail is flushed on a timer, so a crash loses about a
+// second of data.
+// Archive writes (--convert, FlowGenerator) use zstd level 19 and wait instead.
+// A sidecar "<file>.idx" holds one IndexEntry per block so readers can seek by
+// time without touching the data file. Block files go through file_io.hpp
+// (io_uring, O_DIRECT, large aligned chunks).
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include <lz4.h>
+#include <zstd.h>
+#include <simdjson.h>
+#include "file_io.hpp"
+
+enum class Codec : uint8_t { NONE = 0, LZ4 = 1, ZSTD = 2 };
+
+constexpr uint32_t BLOCK_MAGIC = 0x42544648; // "HFTB"
+constexpr size_t BLOCK_SIZE = 256 * 1024;    // raw bytes per block before compression
+constexpr size_t BLOCK_BUFFERS = 4;          // in flight between the hot thread and the I/O thread
+constexpr int64_t BLOCK_MAX_AGE_NS = 1000000000; // LIVE blocks are sealed at least this often...
+constexpr auto FLUSH_INTERVAL = std::chrono::milliseconds(200); // ...and reach the disk within this of it
+
+struct BlockHeader {
+    uint32_t magic;
+    uint8_t codec;
+    uint8_t reserved[3];
+    uint32_t raw_size;
+    uint32_t comp_size;
+    uint32_t records;
+    int64_t first_ns;
+    int64_t last_ns;
+};
+static_assert(sizeof(BlockHeader) == 40);
+
+struct IndexEntry {
+    uint64_t offset;   // of the BlockHeader in the data file
+    int64_t first_ns;
+    int64_t last_ns;
+    uint32_t records;
+    uint32_t raw_size;
+};
+static_assert(sizeof(IndexEntry) == 32);
+
+enum class RecordMode : uint8_t {
+    LIVE,    // market-data thread: zstd level 3, drop (and count) records rather than block
+    ARCHIVE, // offline: zstd level 19, lossless, record() may wait for the writer
+};
+
+inline Codec parse_codec(std::string_view name) {
+    if (name == "lz4") return Codec::LZ4;
+    if (name == "zstd") return Codec::ZSTD;
+    return Codec::NONE;
+}
+
+// Recorder lines are "<recv_ns> <json>"; legacy lines are bare JSON.
+// Returns the receive timestamp (0 if absent) and points `json` past the prefix.
+inline long long split_record(std::string_view line, std::string_view& json) {
+    long long recv_ns = 0;
+    if (!line.empty() && line[0] != '{') {
+        auto [ptr, ec] = std::from_chars(line.data(), line.data() + line.size(), recv_ns);
+        if (ec != std::errc()) recv_ns = 0;
+        while (ptr < line.data() + line.size() && *ptr == ' ') ptr++;
+        json = std::string_view(ptr, line.data() + line.size() - ptr);
+    } else {
+        json = line;
+    }
+    return recv_ns;
+}
+
+// --- WRITER ---
+// record() only appends to the current block; sealed blocks are compressed and
+// written by a background I/O thread so the hot path never waits on a codec.
+class MarketRecorder {
+public:
+    ~MarketRecorder() { close(); }
+
+    // Records lost to a full writer queue (LIVE mode only)
+    long long dropped = 0;
+
+    bool open(const std::string& path, Codec c, RecordMode m = RecordMode::LIVE) {
+        codec = c;
+        mode = m;
+        level = mode == RecordMode::LIVE ? 3 : 19;
+        if (codec == Codec::NONE) {
+            text.open(path, std::ios::app);
+            return text.is_open();
+        }
+
+        if (!repair_tail(path) || !out.open(path)) return false;
+        offset = out.size();
+        index.open(path + ".idx", std::ios::app | std::ios::binary);
+        if (!index.is_open()) return false;
+
+        for (auto& b : blocks) {
+            b.data.reserve(2 * BLOCK_SIZE);
+            free_blocks.push_back(&b);
+        }
+        full_blocks.reserve(BLOCK_BUFFERS);
+        current = take_free();
+        writer = std::thread([this] { run_writer(); });
+        return true;
+    }
+
+    bool is_open() const { return codec == Codec::NONE ? text.is_open() : out.is_open(); }
+
+    void record(long long recv_ns, std::string_view json) {
+        if (codec == Codec::NONE) {
+            text << recv_ns << ' ' << json << "\n";
+            return;
+        }
+
+        if (!writer.joinable()) return; // not open
+        if (!current && !(current = try_take_free())) {
+            if (!dropping) std::cerr << "[RECORDER] Writer behind, dropping records" << std::endl;
+            dropping = true;
+            dropped++;
+            return;
+        }
+        dropping = false;
+        auto& d = current->data;
+        char ts[24];
+        auto [end, ec] = std::to_chars(ts, ts + sizeof(ts), recv_ns);
+        d.insert(d.end(), ts, end);
+        d.push_back(' ');
+        d.insert(d.end(), json.begin(), json.end());
+        d.push_back('\n');
+
+        if (current->records++ == 0) current->first_ns = recv_ns;
+        current->last_ns = recv_ns;
+        if (d.size() >= BLOCK_SIZE || (mode == RecordMode::LIVE && recv_ns - current->first_ns >= BLOCK_MAX_AGE_NS)) seal();
+    }
+
+    void close() {
+        if (codec == Codec::NONE || !writer.joinable()) return;
+        if (current && current->records > 0) seal();
+        {
+            std::lock_guard lock(mu);
+            stopping = true;
+        }
+        cv.notify_all();
+        writer.join();
+        out.close();
+        write_index();
+        report_errors();
+        index.close();
+        if (out.errors) std::cerr << "[RECORDER] " << out.errors << " disk write errors; data after offset " << out.durable_offset() << " is not indexed" << std::endl;
+        if (dropped) std::cerr << "[RECORDER] " << dropped << " records dropped while the writer was behind" << std::endl;
+    }
+
+private:
+    struct Block {
+        std::vector<char> data;
+        int64_t first_ns = 0;
+        int64_t last_ns = 0;
+        uint32_t records = 0;
+    };
+
+    Block* take_free() {
+        std::unique_lock lock(mu);
+        cv.wait(lock, [this] { return !free_blocks.empty(); });
+        Block* b = free_blocks.back();
+        free_blocks.pop_back();
+        return b;
+    }
+
+    Block* try_take_free() {
+        std::lock_guard lock(mu);
+        if (free_blocks.empty()) return nullptr;
+        Block* b = free_blocks.back();
+        free_blocks.pop_back();
+        return b;
+    }
+
+    // In LIVE mode a full queue leaves `current` null; record() drops until a buffer frees up
+    void seal() {
+        {
+            std::lock_guard lock(mu);
+            full_blocks.push_back(current);
+        }
+        cv.notify_all();
+        current = mode == RecordMode::ARCHIVE ? take_free() : try_take_free();
+    }
+
+    void run_writer() {
+        std::vector<char> comp;
+        ZSTD_CCtx* zctx = codec == Codec::ZSTD ? ZSTD_createCCtx() : nullptr;
+
+        auto last_flush = std::chrono::steady_clock::now();
+        bool unflushed = false;
+        auto flush = [&] {
+            out.flush();
+            write_index();
+            report_errors();
+            last_flush = std::chrono::steady_clock::now();
+            unflushed = false;
+        };
+
+        while (true) {
+            Block* b = nullptr;
+            {
+                std::unique_lock lock(mu);
+                auto ready = [this] { return stopping || !full_blocks.empty(); };
+                if (unflushed) cv.wait_until(lock, last_flush + FLUSH_INTERVAL, ready);
+                else cv.wait(lock, ready);
+                if (full_blocks.empty() && stopping) break;
+                if (!full_blocks.empty()) {
+                    b = full_blocks.front();
+                    full_blocks.erase(full_blocks.begin());
+                }
+            }
+            if (!b) { // idle past the interval
+                flush();
+                continue;
+            }
+
+            size_t raw = b->data.size();
+            size_t n = 0;
+            if (codec == Codec::LZ4) {
+                comp.resize(LZ4_compressBound((int)raw));
+                n = LZ4_compress_default(b->data.data(), comp.data(), (int)raw, (int)comp.size());
+            } else {
+                comp.resize(ZSTD_compressBound(raw));
+                n = ZSTD_compressCCtx(zctx, comp.data(), comp.size(), b->data.data(), raw, level);
+                if (ZSTD_isError(n)) n = 0;
+            }
+
+            if (n > 0) {
+                BlockHeader h{BLOCK_MAGIC, (uint8_t)codec, {}, (uint32_t)raw, (uint32_t)n, b->records, b->first_ns, b->last_ns};
+                IndexEntry e{offset, b->first_ns, b->last_ns, b->records, (uint32_t)raw};
+                out.append(reinterpret_cast<const char*>(&h), sizeof(h));
+                out.append(comp.data(), n);
+                offset += sizeof(h) + n;
+                pending_index.push_back({e, offset});
+                unflushed = mode == RecordMode::LIVE;
+                if (unflushed && std::chrono::steady_clock::now() - last_flush >= FLUSH_INTERVAL) flush();
+                write_index();
+                report_errors();
+            } else {
+                std::cerr << "[RECORDER] Compression failed, dropped " << b->records << " records" << std::endl;
+            }
+
+            b->data.clear();
+            b->records = 0;
+            {
+                std::lock_guard lock(mu);
+                free_blocks.push_back(b);
+            }
+            cv.notify_all();
+        }
+        if (zctx) ZSTD_freeCCtx(zctx);
+    }
+
+    // Index entries are written once their whole block is on disk, so a crash
+    // never leaves the index pointing at a torn block.
+    void write_index() {
+        size_t n = 0;
+        for (; n < pending_index.size(); n++) {
+            const PendingEntry& p = pending_index[n];
+            if (p.end > out.durable_offset()) break;
+            index.write(reinterpret_cast<const char*>(&p.entry), sizeof(p.entry));
+        }
+        if (n == 0) return;
+        index.flush();
+        pending_index.erase(pending_index.begin(), pending_index.begin() + n);
+    }
+
+    // A failed write holds the index at the last block before it; later blocks are lost.
+    void report_errors() {
+        if (reported_errors || !out.errors) return; // once; close() reports the total
+        reported_errors = true;
+        std::cerr << "[RECORDER] Disk write failed; recording stops at offset " << out.durable_offset() << std::endl;
+    }
+
+    // A crash can leave a torn block or sector padding after the last complete
+    // block, and complete blocks the index never got. Cuts the data file back to
+    // its last complete block and makes the index match, so appends start clean.
+    static bool repair_tail(const std::string& path) {
+        namespace fs = std::filesystem;
+        std::error_code ec;
+        uint64_t size = fs::file_size(path, ec);
+        if (ec) return true; // new recording
+        std::ifstream data(path, std::ios::binary);
+        if (!data) return false;
+        auto complete_block = [&](uint64_t off, BlockHeader& h) {
+            data.clear();
+            data.seekg((std::streamoff)off);
+            return data.read(reinterpret_cast<char*>(&h), sizeof(h)) && h.magic == BLOCK_MAGIC
+                && off + sizeof(h) + h.comp_size <= size;
+        };
+
+        std::string idx_path = path + ".idx";
+        std::vector<IndexEntry> entries;
+        std::ifstream idx(idx_path, std::ios::binary);
+        IndexEntry e;
+        while (idx.read(reinterpret_cast<char*>(&e), sizeof(e))) entries.push_back(e);
+        idx.close();
+        uint64_t idx_size = fs::file_size(idx_path, ec);
+        if (ec) idx_size = 0;
+
+        // Drop index entries whose block is incomplete, then pick up complete blocks after the last one
+        BlockHeader h;
+        uint64_t end = 0;
+        while (!entries.empty()) {
+            if (complete_block(entries.back().offset, h)) { end = entries.back().offset + sizeof(h) + h.comp_size; break; }
+            entries.pop_back();
+        }
+        size_t kept = entries.size();
+        while (complete_block(end, h)) {
+            entries.push_back({end, h.first_ns, h.last_ns, h.records, h.raw_size});
+            end += sizeof(h) + h.comp_size;
+        }
+
+        if (end < size) {
+            std::cerr << "[RECORDER] " << path << ": cut " << size - end << " bytes of torn tail" << std::endl;
+            fs::resize_file(path, end, ec);
+            if (ec) return false;
+        }
+        if (kept == entries.size() && idx_size == entries.size() * sizeof(IndexEntry)) return true;
+        std::ofstream fixed(idx_path, std::ios::trunc | std::ios::binary);
+        fixed.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(IndexEntry));
+        return (bool)fixed;
+    }
+
+    struct PendingEntry {
+        IndexEntry entry;
+        uint64_t end; // of the block in the data file
+    };
+
+    Codec codec = Codec::NONE;
+    RecordMode mode = RecordMode::LIVE;
+    int level = 3;
+    bool dropping = false;
+    std::ofstream text;
+    DirectAppender out;
+    std::ofstream index;
+    std::vector<PendingEntry> pending_index;
+    uint64_t offset = 0;
+    bool reported_errors = false;
+
+    std::array<Block, BLOCK_BUFFERS> blocks;
+    Block* current = nullptr;
+    std::vector<Block*> free_blocks;
+    std::vector<Block*> full_blocks;
+    std::mutex mu;
+    std::condition_variable cv;
+    bool stopping = false;
+    std::thread writer;
+};
+
+// --- READER ---
+// Yields one record line at a time from either format. In block mode a prefetch
+// thread reads and decompresses the next blocks while the caller replays the
+// current one; decompressed buffers carry simdjson padding so lines can be
+// parsed in place.
+class RecordingReader {
+public:
+    ~RecordingReader() { stop(); }
+
+    // Opens `path` and positions at the first record with recv_ns >= from_ns, or
+    // at `position` (a value previously returned by tell()) when it is non-zero.
+    bool open(const std::string& path, long long from_ns = 0, uint64_t position = 0) {
+        std::ifstream probe(path, std::ios::binary);
+        if (!probe.is_open()) return false;
+        uint32_t magic = 0;
+        probe.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+        block_mode = probe.gcount() == sizeof(magic) && magic == BLOCK_MAGIC;
+        probe.close();
+        skip_before_ns = position ? 0 : from_ns;
+
+        if (!block_mode) {
+            text.open(path);
+            if (position) text.seekg(position);
+            text_offset = position;
+            return text.is_open();
+        }
+
+        if (!in.open(path)) return false;
+        load_index(path);
+
+        // Index entries are in time order: binary-search the first block that ends at or after from_ns
+        auto it = std::lower_bound(entries.begin(), entries.end(), from_ns,
+            [](const IndexEntry& e, long long ts) { return e.last_ns < ts; });
+        next_block = it - entries.begin();
+        if (position) {
+            next_block = position >> 32;
+            first_block_pos = position & 0xffffffff;
+        }
+
+        for (auto& b : blocks) free_blocks.push_back(&b);
+        prefetcher = std::thread([this] { run_prefetch(); });
+        return true;
+    }
+
+    // True when returned lines are followed by at least SIMDJSON_PADDING readable bytes.
+    bool padded() const { return block_mode; }
+
+    // Opaque position of the record the next call to next() returns: the byte
+    // offset in plain mode, (block number << 32 | offset in block) in block mode.
+    uint64_t tell() const {
+        if (!block_mode) return text_offset;
+        if (!current) return (uint64_t)next_block << 32 | first_block_pos;
+        return (uint64_t)current->number << 32 | current->pos;
+    }
+
+    // Number of blocks described by the index (0 in plain mode).
+    size_t block_count() const { return entries.size(); }
+
+    bool next(std::string_view& line) {
+        while (true) {
+            if (!read_line(line)) return false;
+            if (skip_before_ns == 0) return true;
+
+            std::string_view json;
+            long long ts = split_record(line, json);
+            if (ts != 0 && ts < skip_before_ns) continue;
+            skip_before_ns = 0;
+            return true;
+        }
+    }
+
+private:
+    struct Block {
+        std::vector<char> data; // raw_size + simdjson::SIMDJSON_PADDING
+        size_t size = 0;
+        size_t pos = 0;
+        size_t number = 0;
+        bool last = false;
+    };
+
+    bool read_line(std::string_view& line) {
+        if (!block_mode) {
+            if (!std::getline(text, text_line)) return false;
+            line = text_line;
+            text_offset += text_line.size() + 1;
+            return true;
+        }
+
+        while (!current || current->pos >= current->size) {
+            if (current) {
+                bool was_last = current->last;
+                release(current);
+                current = nullptr;
+                if (was_last) return false;
+            }
+            current = take_ready();
+        }
+
+        const char* begin = current->data.data() + current->pos;
+        const char* end = static_cast<const char*>(std::memchr(begin, '\n', current->size - current->pos));
+        if (!end) end = current->data.data() + current->size;
+        line = std::string_view(begin, end - begin);
+        current->pos = (end - current->data.data()) + 1;
+        return true;
+    }
+
+    // Missing or truncated index: rebuild it by hopping over block headers.
+    void load_index(const std::string& path) {
+        std::ifstream idx(path + ".idx", std::ios::binary);
+        IndexEntry e;
+        while (idx.read(reinterpret_cast<char*>(&e), sizeof(e))) entries.push_back(e);
+
+        uint64_t off = entries.empty() ? 0 : entries.back().offset;
+        if (!entries.empty()) {
+            BlockHeader h;
+            if (!in.read(off, reinterpret_cast<char*>(&h), sizeof(h))) return;
+            off += sizeof(h) + h.comp_size;
+        }
+        BlockHeader h;
+        while (in.read(off, reinterpret_cast<char*>(&h), sizeof(h)) && h.magic == BLOCK_MAGIC
+               && off + sizeof(h) + h.comp_size <= in.size()) { // a torn block after a crash is left out
+            entries.push_back({off, h.first_ns, h.last_ns, h.records, h.raw_size});
+            off += sizeof(h) + h.comp_size;
+        }
+    }
+
+    void run_prefetch() {
+        std::vector<char> comp;
+        ZSTD_DCtx* zctx = ZSTD_createDCtx();
+
+        for (size_t i = next_block; ; i++) {
+            Block* b;
+            {
+                std::unique_lock lock(mu);
+                cv.wait(lock, [this] { return stopping || !free_blocks.empty(); });
+                if (stopping) break;
+                b = free_blocks.back();
+                free_blocks.pop_back();
+            }
+
+            b->size = 0;
+            b->pos = (i == next_block) ? first_block_pos : 0;
+            b->number = i;
+            b->last = true;
+            if (i < entries.size()) {
+                BlockHeader h;
+                uint64_t off = entries[i].offset;
+                if (in.read(off, reinterpret_cast<char*>(&h), sizeof(h)) && h.magic == BLOCK_MAGIC) {
+                    comp.resize(h.comp_size);
+                    b->data.resize(h.raw_size + simdjson::SIMDJSON_PADDING);
+                    if (in.read(off + sizeof(h), comp.data(), h.comp_size)) {
+                        long long n = -1;
+                        if (h.codec == (uint8_t)Codec::LZ4) {
+                            n = LZ4_decompress_safe(comp.data(), b->data.data(), (int)h.comp_size, (int)h.raw_size);
+                        } else if (h.codec == (uint8_t)Codec::ZSTD) {
+                            size_t r = ZSTD_decompressDCtx(zctx, b->data.data(), h.raw_size, comp.data(), h.comp_size);
+                            n = ZSTD_isError(r) ? -1 : (long long)r;
+                        }
+                        if (n == (long long)h.raw_size) {
+                            b->size = h.raw_size;
+                            b->last = (i + 1 == entries.size());
+                        } else {
+                            std::cerr << "[REPLAY] Corrupt block at offset " << entries[i].offset << std::endl;
+                        }
+                    }
+                }
+            }
+
+            {
+                std::lock_guard lock(mu);
+                ready_blocks.push_back(b);
+            }
+            cv.notify_all();
+            if (b->last) break;
+        }
+        ZSTD_freeDCtx(zctx);
+    }
+
+    Block* take_ready() {
+        std::unique_lock lock(mu);
+        cv.wait(lock, [this] { return !ready_blocks.empty(); });
+        Block* b = ready_blocks.front();
+        ready_blocks.erase(ready_blocks.begin());
+        return b;
+    }
+
+    void release(Block* b) {
+        {
+            std::lock_guard lock(mu);
+            free_blocks.push_back(b);
+        }
+        cv.notify_all();
+    }
+
+    void stop() {
+        if (!prefetcher.joinable()) return;
+        {
+            std::lock_guard lock(mu);
+            stopping = true;
+        }
+        cv.notify_all();
+        prefetcher.join();
+    }
+
+    bool block_mode = false;
+    long long skip_before_ns = 0;
+    std::ifstream text;
+    std::string text_line;
+    uint64_t text_offset = 0;
+
+    ReadaheadFile in;
+    std::vector<IndexEntry> entries;
+    size_t next_block = 0;
+    size_t first_block_pos = 0;
+
+    std::array<Block, BLOCK_BUFFERS> blocks;
+    Block* current = nullptr;
+    std::vector<Block*> free_blocks;
+    std::vector<Block*> ready_blocks;
+    std::mutex mu;
+    std::condition_variable cv;
+    bool stopping = false;
+    std::thread prefetcher;
+};
@@ -0,0 +1,288 @@
+#pragma once
+// Live engine metrics. The hot thread is the only writer: it stores counters,
+// gauges and latency histograms into a page of shared memory
+// (/dev/shm/hft_metrics.<pid>, or --metrics-name) with relaxed atomic stores.
+// That is one plain mov per value and there are no locks or read-modify-write
+// instructions. Readers only load from the page: the Prometheus exporter thread
+// below, or any other process that maps it. A scrape costs the hot thread at
+// most one cache miss per page line it touched afterwards. Values are
+// individually exact but a scrape is not an atomic snapshot across them.
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <cstdio>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <memory_resource>
+#include <stdexcept>
+#include <stop_token>
+#include <string>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0 // macOS: SO_NOSIGPIPE is set on the client socket instead
+#endif
+
+// --- 1. METRICS PAGE ---
+namespace metric {
+enum Counter {
+    MESSAGES, BYTES, STRATEGY_RUNS, STRATEGY_SKIPPED, ORDERS_SENT, RISK_REJECTS,
+    BOOK_VERIFIED, BOOK_GAPS, BOOK_CROSSED, BOOK_DIVERGENCES, RESYNCS,
+    BACKLOGGED, CONFLATED, BACKLOG_BURSTS, RECORDS_DROPPED, COUNTER_COUNT
+};
+enum Gauge {
+    BACKLOG_BYTES, BACKLOG_MAX_BYTES, CATCHUP_MAX_SECONDS, ARENA_USED_BYTES, ARENA_BYTES,
+    POSITION, BEST_BID, BEST_ASK, LAST_UPDATE_ID, GAUGE_COUNT
+};
+enum Histogram { KERNEL_TO_READ, READ_TO_PARSE, UPDATE_TO_BOOK, ORDER_SEND, HISTOGRAM_COUNT };
+} // namespace metric
+
+struct MetricDesc { const char* name; const char* help; };
+
+inline constexpr MetricDesc COUNTER_DESC[metric::COUNTER_COUNT] = {
+    {"hft_messages_total", "Market-data messages read"},
+    {"hft_message_bytes_total", "Market-data bytes read"},
+    {"hft_strategy_runs_total", "Strategy evaluations"},
+    {"hft_strategy_skipped_total", "Updates skipped because the top levels did not change"},
+    {"hft_orders_sent_total", "Orders sent to the gateway"},
+    {"hft_risk_rejects_total", "Orders rejected by pre-trade risk"},
+    {"hft_book_verified_total", "Book checksums matched against exchange snapshots"},
+    {"hft_book_gaps_total", "Sequence gaps in the update stream"},
+    {"hft_book_crossed_total", "Crossed books detected"},
+    {"hft_book_divergences_total", "Book checksums that disagreed with a snapshot"},
+    {"hft_resyncs_total", "Book resynchronisations"},
+    {"hft_backlogged_total", "Messages processed with more input already queued"},
+    {"hft_conflated_total", "Messages whose strategy stage was skipped to catch up"},
+    {"hft_backlog_bursts_total", "Periods spent behind the feed"},
+    {"hft_recorder_dropped_total", "Records the market-data recorder dropped because its writer was behind"},
+};
+
+inline constexpr MetricDesc GAUGE_DESC[metric::GAUGE_COUNT] = {
+    {"hft_backlog_bytes", "Bytes queued on the transport behind the last message"},
+    {"hft_backlog_max_bytes", "Largest backlog seen"},
+    {"hft_catchup_max_seconds", "Longest time spent behind the feed"},
+    {"hft_arena_used_bytes", "Book memory handed out (beyond hft_arena_bytes spills to the heap)"},
+    {"hft_arena_bytes", "Book memory arena size"},
+    {"hft_position", "Net position, base units"},
+    {"hft_best_bid", "Best bid"},
+    {"hft_best_ask", "Best ask"},
+    {"hft_last_update_id", "Last applied exchange update ID"},
+};
+
+inline constexpr MetricDesc HISTOGRAM_DESC[metric::HISTOGRAM_COUNT] = {
+    {"hft_kernel_to_read_seconds", "Kernel receive timestamp to read() returning"},
+    {"hft_read_to_parse_seconds", "read() returning to levels parsed"},
+    {"hft_update_seconds", "Message parsed and applied to the book"},
+    {"hft_order_send_seconds", "Gateway order encode and send"},
+};
+
+// Power-of-two buckets: 64 ns .. 2^26 ns (67 ms), then +Inf
+struct alignas(64) MetricsHistogram {
+    static constexpr int MIN_SHIFT = 6;
+    static constexpr int BUCKETS = 21;
+
+    std::atomic<uint64_t> buckets[BUCKETS + 1];
+    std::atomic<uint64_t> sum_ns;
+
+    static double upper_bound_s(int i) { return double(1ull << (i + MIN_SHIFT)) * 1e-9; }
+};
+
+// Fixed layout so other processes can map it; bump VERSION on any change
+struct MetricsPage {
+    static constexpr uint64_t MAGIC = 0x5346454d54464821ull; // "!HFTMEFS"
+    static constexpr uint64_t VERSION = 2;
+
+    uint64_t magic;
+    uint64_t version;
+    alignas(64) std::atomic<uint64_t> counters[metric::COUNTER_COUNT];
+    alignas(64) std::atomic<double> gauges[metric::GAUGE_COUNT];
+    MetricsHistogram histograms[metric::HISTOGRAM_COUNT];
+};
+static_assert(std::atomic<double>::is_always_lock_free && std::atomic<uint64_t>::is_always_lock_free);
+
+// --- 2. HOT-THREAD WRITER ---
+class Telemetry {
+public:
+    // One page per engine: `name` (e.g. "/hft_metrics.live"), by default
+    // "/hft_metrics.<pid>". An existing page is never reused, since it may
+    // belong to another live engine; the metrics then stay private.
+    explicit Telemetry(std::string name = {})
+        : shm_name(name.empty() ? "/hft_metrics." + std::to_string(::getpid()) : std::move(name)) {
+        if (shm_name[0] != '/') shm_name.insert(0, 1, '/');
+        int fd = ::shm_open(shm_name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+        if (fd < 0 && errno == EEXIST)
+            std::cerr << "[METRICS] /dev/shm" << shm_name << " already exists (another engine, or left by a crash); metrics stay private" << std::endl;
+        if (fd >= 0 && ::ftruncate(fd, sizeof(MetricsPage)) == 0) {
+            void* p = ::mmap(nullptr, sizeof(MetricsPage), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if (p != MAP_FAILED) { page = static_cast<MetricsPage*>(p); shared = true; }
+        }
+        if (fd >= 0) ::close(fd);
+        if (fd >= 0 && !shared) ::shm_unlink(shm_name.c_str()); // created but unusable
+        if (!page) { // no /dev/shm: keep the metrics private to this process
+            void* p = ::mmap(nullptr, sizeof(MetricsPage), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (p == MAP_FAILED) throw std::runtime_error("metrics page: " + std::string(std::strerror(errno)));
+            page = static_cast<MetricsPage*>(p);
+        }
+        std::memset((void*)page, 0, sizeof(MetricsPage)); // also faults the page in
+        page->magic = MetricsPage::MAGIC;
+        page->version = MetricsPage::VERSION;
+    }
+
+    ~Telemetry() {
+        ::munmap(page, sizeof(MetricsPage));
+        if (shared) ::shm_unlink(shm_name.c_str());
+    }
+
+    Telemetry(const Telemetry&) = delete;
+    Telemetry& operator=(const Telemetry&) = delete;
+
+    void add(metric::Counter c, uint64_t n = 1) {
+        auto& v = page->counters[c];
+        v.store(v.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+    void set(metric::Counter c, uint64_t v) { page->counters[c].store(v, std::memory_order_relaxed); }
+    void set(metric::Gauge g, double v) { page->gauges[g].store(v, std::memory_order_relaxed); }
+
+    void observe(metric::Histogram h, long long ns) {
+        MetricsHistogram& m = page->histograms[h];
+        uint64_t v = (uint64_t)std::max(ns, 0LL);
+        int i = std::max(0, (int)std::bit_width(v ? v - 1 : 0) - MetricsHistogram::MIN_SHIFT);
+        auto bump = [](std::atomic<uint64_t>& a, uint64_t n) {
+            a.store(a.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+        };
+        bump(m.buckets[std::min(i, MetricsHistogram::BUCKETS)], 1);
+        bump(m.sum_ns, v);
+    }
+
+    const MetricsPage& read() const { return *page; }
+    bool is_shared() const { return shared; }
+    const std::string& name() const { return shm_name; }
+
+private:
+    std::string shm_name;
+    MetricsPage* page = nullptr;
+    bool shared = false;
+};
+
+// Counts bytes the book takes from its arena. A monotonic arena never gives
+// memory back, so the total is also its high-water mark.
+class CountingResource : public std::pmr::memory_resource {
+public:
+    explicit CountingResource(std::pmr::memory_resource* upstream) : upstream(upstream) {}
+
+    size_t allocated = 0;
+
+private:
+    void* do_allocate(size_t bytes, size_t align) override {
+        allocated += bytes;
+        return upstream->allocate(bytes, align);
+    }
+    void do_deallocate(void* p, size_t bytes, size_t align) override { upstream->deallocate(p, bytes, align); }
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+    std::pmr::memory_resource* upstream;
+};
+
+// --- 3. PROMETHEUS EXPORTER ---
+// Serves GET /metrics on 127.0.0.1:<port> from its own thread, at SCHED_IDLE
+// on Linux so it only runs on CPU time nothing else wants. Other paths get a 404.
+class MetricsServer {
+public:
+    ~MetricsServer() { if (fd >= 0) ::close(fd); }
+
+    bool open(uint16_t port) {
+        fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        if (fd < 0) return false;
+        int one = 1;
+        ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (::bind(fd, (sockaddr*)&addr, sizeof(addr)) < 0 || ::listen(fd, 8) < 0) {
+            ::close(fd);
+            fd = -1;
+            return false;
+        }
+        return true;
+    }
+
+    void run(std::stop_token stop, const MetricsPage& page) {
+#if defined(__linux__)
+        sched_param idle{};
+        ::sched_setscheduler(0, SCHED_IDLE, &idle); // this thread only
+#endif
+        std::string body;
+        char request[2048];
+        while (!stop.stop_requested()) {
+            pollfd p{fd, POLLIN, 0};
+            if (::poll(&p, 1, 200) <= 0) continue;
+            int client = ::accept(fd, nullptr, nullptr);
+            if (client < 0) continue;
+#if defined(SO_NOSIGPIPE)
+            int one = 1;
+            ::setsockopt(client, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+            timeval timeout{1, 0};
+            ::setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+            ssize_t n = ::recv(client, request, sizeof(request) - 1, 0);
+            bool ok = n > 0 && std::strncmp(request, "GET /metrics", 12) == 0;
+            if (ok) {
+                body.clear();
+                render(page, body);
+            }
+            char header[160];
+            int h = ok ? snprintf(header, sizeof(header), "HTTP/1.1 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n"
+                                  "Content-Length: %zu\r\nConnection: close\r\n\r\n", body.size())
+                       : snprintf(header, sizeof(header), "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+            ::send(client, header, h, MSG_NOSIGNAL);
+            if (ok) ::send(client, body.data(), body.size(), MSG_NOSIGNAL);
+            ::close(client);
+        }
+    }
+
+    // Prometheus text exposition format
+    static void render(const MetricsPage& page, std::string& out) {
+        char line[256];
+        auto emit = [&](int n) { out.append(line, std::min(n, (int)sizeof(line) - 1)); };
+        for (int c = 0; c < metric::COUNTER_COUNT; c++) {
+            const MetricDesc& d = COUNTER_DESC[c];
+            emit(snprintf(line, sizeof(line), "# HELP %s %s\n# TYPE %s counter\n%s %llu\n", d.name, d.help, d.name, d.name,
+                          (unsigned long long)page.counters[c].load(std::memory_order_relaxed)));
+        }
+        for (int g = 0; g < metric::GAUGE_COUNT; g++) {
+            const MetricDesc& d = GAUGE_DESC[g];
+            emit(snprintf(line, sizeof(line), "# HELP %s %s\n# TYPE %s gauge\n%s %.17g\n", d.name, d.help, d.name, d.name,
+                          page.gauges[g].load(std::memory_order_relaxed)));
+        }
+        for (int h = 0; h < metric::HISTOGRAM_COUNT; h++) {
+            const MetricDesc& d = HISTOGRAM_DESC[h];
+            const MetricsHistogram& m = page.histograms[h];
+            emit(snprintf(line, sizeof(line), "# HELP %s %s\n# TYPE %s histogram\n", d.name, d.help, d.name));
+            // Buckets are cumulative; read them first so _count is never below the last bucket
+            uint64_t cumulative = 0;
+            for (int i = 0; i <= MetricsHistogram::BUCKETS; i++) {
+                cumulative += m.buckets[i].load(std::memory_order_relaxed);
+                if (i < MetricsHistogram::BUCKETS) {
+                    emit(snprintf(line, sizeof(line), "%s_bucket{le=\"%.9g\"} %llu\n", d.name,
+                                  MetricsHistogram::upper_bound_s(i), (unsigned long long)cumulative));
+                } else {
+                    emit(snprintf(line, sizeof(line), "%s_bucket{le=\"+Inf\"} %llu\n", d.name, (unsigned long long)cumulative));
+                }
+            }
+            emit(snprintf(line, sizeof(line), "%s_sum %.9f\n%s_count %llu\n", d.name,
+                          m.sum_ns.load(std::memory_order_relaxed) * 1e-9, d.name, (unsigned long long)cumulative));
+        }
+    }
+
+private:
+    int fd = -1;
+};
@@ -0,0 +1,85 @@
+#pragma once
+// Client TLS shared by the market-data stream and the snapshot connections.
+//
+// TLS 1.3 is preferred with TLS 1.2 as the floor. AES-GCM suites come first:
+// AES-NI / ARMv8 crypto extensions make them the cheapest per-record ciphers,
+// with ChaCha20-Poly1305 kept as a fallback for CPUs without them. Every
+// connection offers the last session ticket its host issued. A reconnect or a
+// fresh snapshot connection then resumes with an abbreviated handshake and
+// skips the certificate exchange and its signature checks.
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <boost/asio/ssl.hpp>
+#include <openssl/ssl.h>
+
+// One resumable session per host. TLS 1.3 issues tickets after the handshake,
+// so sessions are captured by OpenSSL's new-session callback rather than
+// read back once handshake() returns. Shared by the hot thread and the verifier.
+class TlsSessionCache {
+public:
+    ~TlsSessionCache() {
+        for (auto& [host, session] : sessions) SSL_SESSION_free(session);
+    }
+
+    // Sets SNI (which also keys the cache) and offers the cached session, if any.
+    void prepare(SSL* ssl, const std::string& host) {
+        SSL_set_tlsext_host_name(ssl, host.c_str());
+        std::lock_guard lock(mtx);
+        auto it = sessions.find(host);
+        if (it != sessions.end()) SSL_set_session(ssl, it->second);
+    }
+
+    static int on_new_session(SSL* ssl, SSL_SESSION* session) {
+        const char* host = SSL_get_servername(ssl, TLSEXT_NAMETYPE_host_name);
+        if (!host) return 0;
+        TlsSessionCache& cache = instance();
+        std::lock_guard lock(cache.mtx);
+        SSL_SESSION*& slot = cache.sessions[host];
+        if (slot) SSL_SESSION_free(slot);
+        slot = session;
+        return 1; // we keep the reference
+    }
+
+    static TlsSessionCache& instance() {
+        static TlsSessionCache cache;
+        return cache;
+    }
+
+private:
+    std::mutex mtx;
+    std::unordered_map<std::string, SSL_SESSION*> sessions;
+};
+
+inline void configure_tls(boost::asio::ssl::context& ctx) {
+    SSL_CTX* c = ctx.native_handle();
+    SSL_CTX_set_min_proto_version(c, TLS1_2_VERSION);
+    SSL_CTX_set_ciphersuites(c, "TLS_AES_128_GCM_SHA256:TLS_AES_256_GCM_SHA384:TLS_CHACHA20_POLY1305_SHA256");
+    SSL_CTX_set_cipher_list(c, "ECDHE-ECDSA-AES128-GCM-SHA256:ECDHE-RSA-AES128-GCM-SHA256:"
+                               "ECDHE-ECDSA-AES256-GCM-SHA384:ECDHE-RSA-AES256-GCM-SHA384:"
+                               "ECDHE-ECDSA-CHACHA20-POLY1305:ECDHE-RSA-CHACHA20-POLY1305");
+    SSL_CTX_set_session_cache_mode(c, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+    SSL_CTX_sess_set_new_cb(c, &TlsSessionCache::on_new_session);
+}
+
+// Client handshake on a connected stream, resuming when possible. Logs the
+// negotiated version and cipher, whether the session was resumed, and the time.
+template <class SslStream>
+void tls_handshake(SslStream& stream, const std::string& host, const char* label) {
+    SSL* ssl = stream.native_handle();
+    TlsSessionCache::instance().prepare(ssl, host);
+    auto start = std::chrono::steady_clock::now();
+    stream.handshake(boost::asio::ssl::stream_base::client);
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "[TLS] " << label << " " << host << ": " << SSL_get_version(ssl) << " " << SSL_get_cipher_name(ssl)
+              << (SSL_session_reused(ssl) ? ", resumed" : ", full") << " handshake " << us << " us" << std::endl;
+}
+
+// Call before dropping a connection without a close_notify exchange. OpenSSL
+// otherwise treats the unclean close as an error and marks the session
+// non-resumable.
+inline void tls_abandon(SSL* ssl) {
+    SSL_set_shutdown(ssl, SSL_SENT_SHUTDOWN | SSL_RECEIVED_SHUTDOWN);
+}
@@ -0,0 +1,176 @@
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include "flight_recorder.hpp"
+
+// Converts a flight-recorder dump (flight_*.trace) into Chrome trace event
+// JSON, which chrome://tracing and ui.perfetto.dev open directly. Each message
+// is a slice on the "hot thread" track with its stages nested inside, and
+// kernel->read waits are on a separate "network" track. Also prints the slowest
+// messages with their per-stage breakdown.
+
+// --- 1. LOADING ---
+bool load(const std::string& path, TraceFileHeader& h, std::vector<TraceRecord>& records) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in.read(reinterpret_cast<char*>(&h), sizeof(h))) return false;
+    if (std::memcmp(h.magic, TraceFileHeader::MAGIC, sizeof(h.magic)) != 0 || h.version != TraceFileHeader::VERSION ||
+        h.record_size != sizeof(TraceRecord)) {
+        std::cerr << "Error: " << path << " is not a version " << TraceFileHeader::VERSION << " flight-recorder dump" << std::endl;
+        return false;
+    }
+    records.resize(h.count);
+    in.read(reinterpret_cast<char*>(records.data()), h.count * sizeof(TraceRecord));
+    records.resize(in.gcount() / sizeof(TraceRecord)); // tolerate a truncated dump
+    return true;
+}
+
+// Receive -> order sent, or as far as the message got (same as FlightRecorder::finish)
+long long total_ns(const TraceRecord& r) {
+    return std::max({r.apply_ns, r.decide_ns, r.send_ns}) + (r.recv_ns ? r.read_ns - r.recv_ns : 0);
+}
+
+// --- 2. CHROME TRACE JSON ---
+class TraceWriter {
+public:
+    TraceWriter(std::ostream& out, long long origin_ns) : out(out), origin_ns(origin_ns) {
+        out << "{\"displayTimeUnit\":\"ns\",\"otherData\":{\"origin_unix_ns\":" << origin_ns << "},\"traceEvents\":[\n";
+        meta(1, "network");
+        meta(2, "hot thread");
+    }
+
+    ~TraceWriter() { out << "\n]}\n"; }
+
+    // Complete event; times in absolute ns, written as us relative to the origin
+    void slice(int tid, const char* name, long long start_ns, long long dur_ns, const char* args = nullptr) {
+        if (dur_ns < 0) return;
+        char buf[512];
+        std::snprintf(buf, sizeof(buf), "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f%s%s%s}",
+                      name, tid, (start_ns - origin_ns) / 1000.0, dur_ns / 1000.0,
+                      args ? ",\"args\":{" : "", args ? args : "", args ? "}" : "");
+        event(buf);
+    }
+
+    void instant(int tid, const char* name, long long at_ns) {
+        char buf[192];
+        std::snprintf(buf, sizeof(buf), "{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":%d,\"ts\":%.3f}",
+                      name, tid, (at_ns - origin_ns) / 1000.0);
+        event(buf);
+    }
+
+private:
+    void meta(int tid, const char* name) {
+        char buf[160];
+        std::snprintf(buf, sizeof(buf), "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}", tid, name);
+        event(buf);
+    }
+
+    void event(const char* json) {
+        if (!first) out << ",\n";
+        first = false;
+        out << json;
+    }
+
+    std::ostream& out;
+    long long origin_ns;
+    bool first = true;
+};
+
+void write_trace(std::ostream& out, const std::vector<TraceRecord>& records) {
+    long long origin = records.front().recv_ns ? std::min(records.front().recv_ns, records.front().read_ns) : records.front().read_ns;
+    TraceWriter w(out, origin);
+    for (const TraceRecord& r : records) {
+        const char* side = (r.flags & TraceRecord::SELL) ? "SELL" : "BUY";
+        if (r.recv_ns) w.slice(1, "kernel->read", r.recv_ns, r.read_ns - r.recv_ns);
+
+        int end = std::max({r.parse_ns, r.apply_ns, r.decide_ns, r.send_ns});
+        char name[64], args[256];
+        std::snprintf(name, sizeof(name), "%s%s%s", to_string(r.outcome),
+                      r.outcome == TraceOutcome::ORDER || r.outcome == TraceOutcome::REJECT ? " " : "",
+                      r.outcome == TraceOutcome::ORDER || r.outcome == TraceOutcome::REJECT ? side : "");
+        std::snprintf(args, sizeof(args), "\"seq\":%llu,\"u\":%lld,\"bytes\":%u,\"levels\":%u,\"queued\":%u,\"total_ns\":%lld",
+                      (unsigned long long)r.seq, (long long)r.update_id, r.bytes, (unsigned)r.levels, r.pending, total_ns(r));
+        w.slice(2, name, r.read_ns, end, args);
+        if (r.parse_ns) w.slice(2, "parse", r.read_ns, r.parse_ns);
+        const char* book = r.outcome == TraceOutcome::SNAPSHOT ? "snapshot load"
+                         : r.outcome == TraceOutcome::RESYNC ? "book + resync"
+                         : r.outcome == TraceOutcome::DROPPED ? "snapshot retry" : "book";
+        if (r.apply_ns) w.slice(2, book, r.read_ns + r.parse_ns, r.apply_ns - r.parse_ns);
+        if (r.decide_ns) w.slice(2, "strategy", r.read_ns + r.apply_ns, r.decide_ns - r.apply_ns);
+        if (r.send_ns) w.slice(2, "order send", r.read_ns + r.decide_ns, r.send_ns - r.decide_ns);
+        if (r.flags & TraceRecord::BREACH) w.instant(2, "latency breach", r.read_ns + end);
+    }
+}
+
+// --- 3. SUMMARY ---
+void print_summary(const TraceFileHeader& h, const std::vector<TraceRecord>& records, size_t top) {
+    std::cout << "[TRACE] " << records.size() << " messages, reason " << h.reason;
+    if (h.threshold_ns) std::cout << ", threshold " << h.threshold_ns / 1000 << " us";
+    std::cout << std::endl;
+
+    long long outcomes[16] = {}, breaches = 0;
+    for (const TraceRecord& r : records) {
+        outcomes[(size_t)r.outcome & 15]++;
+        if (r.flags & TraceRecord::BREACH) breaches++;
+    }
+    std::cout << "Outcomes:";
+    for (int o = 0; o <= (int)TraceOutcome::REJECT; o++) {
+        if (outcomes[o]) std::cout << " " << to_string((TraceOutcome)o) << "=" << outcomes[o];
+    }
+    std::cout << "\nBreaches: " << breaches << std::endl;
+
+    std::vector<const TraceRecord*> slowest;
+    for (const TraceRecord& r : records) slowest.push_back(&r);
+    top = std::min(top, slowest.size());
+    std::partial_sort(slowest.begin(), slowest.begin() + top, slowest.end(),
+                      [](const TraceRecord* a, const TraceRecord* b) { return total_ns(*a) > total_ns(*b); });
+    std::cout << "Slowest messages (ns):\n" << std::setw(10) << "seq" << std::setw(12) << "u" << std::setw(10) << "total"
+              << std::setw(10) << "kernel" << std::setw(10) << "parse" << std::setw(10) << "book" << std::setw(10) << "strategy"
+              << std::setw(10) << "send" << std::setw(8) << "bytes" << std::setw(8) << "levels" << "  outcome" << std::endl;
+    for (size_t i = 0; i < top; i++) {
+        const TraceRecord& r = *slowest[i];
+        std::cout << std::setw(10) << r.seq << std::setw(12) << r.update_id << std::setw(10) << total_ns(r)
+                  << std::setw(10) << (r.recv_ns ? r.read_ns - r.recv_ns : 0) << std::setw(10) << r.parse_ns
+                  << std::setw(10) << (r.apply_ns ? r.apply_ns - r.parse_ns : 0)
+                  << std::setw(10) << (r.decide_ns ? r.decide_ns - r.apply_ns : 0)
+                  << std::setw(10) << (r.send_ns ? r.send_ns - r.decide_ns : 0)
+                  << std::setw(8) << r.bytes << std::setw(8) << r.levels << "  " << to_string(r.outcome) << std::endl;
+    }
+}
+
+// --- 4. MAIN ---
+int main(int argc, char** argv) {
+    std::string input, out_path;
+    size_t top = 10;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--out") == 0 && i + 1 < argc) out_path = argv[++i];
+        else if (std::strcmp(argv[i], "--top") == 0 && i + 1 < argc) top = (size_t)std::max(0, std::atoi(argv[++i]));
+        else if (argv[i][0] != '-') input = argv[i];
+    }
+    if (input.empty()) {
+        std::cerr << "Usage: TraceExport <flight_*.trace> [--out trace.json] [--top N]" << std::endl;
+        return 1;
+    }
+    if (out_path.empty()) out_path = input.substr(0, input.rfind(".trace")) + ".json";
+
+    TraceFileHeader header;
+    std::vector<TraceRecord> records;
+    if (!load(input, header, records)) {
+        std::cerr << "Error: cannot read " << input << std::endl;
+        return 1;
+    }
+    if (records.empty()) {
+        std::cerr << "Error: " << input << " holds no records" << std::endl;
+        return 1;
+    }
+
+    print_summary(header, records, top);
+    std::ofstream out(out_path);
+    write_trace(out, records);
+    std::cout << "[TRACE] Wrote " << out_path << " (open in ui.perfetto.dev or chrome://tracing)" << std::endl;
+    return 0;
+}
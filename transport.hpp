@@ -0,0 +1,507 @@
+#pragma once
+// Market-data transports under the feed handler. Each one hands the engine one
+// message at a time as a view that stays valid until the next read(), together
+// with its receive time. Views live in preallocated memory; when padded() is
+// true at least SIMDJSON_PADDING readable bytes follow, so simdjson parses
+// them in place:
+//
+//   AsioFeed        Boost.Beast WebSocket over TLS over a kernel TCP socket (default),
+//                   with optional SocketTuning and kernel receive timestamps.
+//   PacketRingFeed  Linux packet-mmap RX ring (TPACKET_V2) on one interface; each
+//                   UDP datagram to `port` is one message. The hot thread spins on
+//                   the shared ring, so no syscall is made per packet and frames
+//                   are parsed in place. Payloads are plaintext: an exchange UDP
+//                   feed, a local TLS-terminating relay, or FlowGenerator --udp
+//                   on a veth pair.
+//   ReplayFeed      A recording (text or block format) read back as fast as
+//                   possible: the live hot loop without a network, for
+//                   benchmarks and PGO training runs.
+//
+// The engine's loop is a template over the feed, so the choice costs no
+// virtual call on the hot path.
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <boost/beast/core.hpp>
+#include <boost/beast/ssl.hpp>
+#include <boost/beast/websocket.hpp>
+#include <boost/beast/websocket/ssl.hpp>
+#include <boost/asio/connect.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <simdjson.h>
+#include "tls.hpp"
+#include "recording.hpp"
+#if defined(__linux__)
+#include <arpa/inet.h>
+#include <linux/if_ether.h>
+#include <linux/if_packet.h>
+#include <net/if.h>
+#include <linux/errqueue.h>
+#include <linux/net_tstamp.h>
+#include <linux/sockios.h>
+#include <netinet/ip.h>
+#include <netinet/tcp.h>
+#include <netinet/udp.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+// Largest message either feed delivers; also the parser's preallocated capacity.
+constexpr size_t MAX_MESSAGE = 256 * 1024;
+
+// Sizes the parser and its document for MAX_MESSAGE up front. simdjson grows
+// the document on demand, which would allocate on the hot path whenever a
+// message is larger than any seen before.
+inline bool preallocate_parser(simdjson::dom::parser& parser) {
+    if (parser.allocate(MAX_MESSAGE) != simdjson::SUCCESS) return false;
+    std::string warmup(MAX_MESSAGE, ' ');
+    warmup[0] = '0';
+    return parser.parse(warmup).error() == simdjson::SUCCESS;
+}
+
+inline long long wall_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// Per-message latency between two points of the receive path (mean/max).
+struct RxLatency {
+    long long count = 0;
+    long long total_ns = 0;
+    long long max_ns = 0;
+
+    void add(long long from_ns, long long to_ns) {
+        long long d = to_ns - from_ns;
+        count++;
+        total_ns += d;
+        max_ns = std::max(max_ns, d);
+    }
+    long long mean_ns() const { return count ? total_ns / count : 0; }
+};
+
+// --- 1. SOCKET TUNING ---
+enum class RxTimestamps { NONE, SOFTWARE, HARDWARE };
+
+inline RxTimestamps parse_rx_timestamps(std::string_view name) {
+    if (name == "none") return RxTimestamps::NONE;
+    if (name == "hw") return RxTimestamps::HARDWARE;
+    return RxTimestamps::SOFTWARE;
+}
+
+// Options for the market-data TCP socket. Everything but TCP_NODELAY and
+// SO_RCVBUF is Linux-only and ignored elsewhere.
+struct SocketTuning {
+    bool nodelay = true;        // TCP_NODELAY: no Nagle delay on our outgoing frames (pongs, acks)
+    bool quickack = false;      // TCP_QUICKACK, re-armed after every read since the kernel clears it
+    int busy_poll_us = 0;       // SO_BUSY_POLL: spin on the NIC queue this long before sleeping (0 = off)
+    int rcvbuf = 0;             // SO_RCVBUF bytes (0 = kernel default)
+    RxTimestamps timestamps = RxTimestamps::SOFTWARE; // SO_TIMESTAMPING on receive
+    std::string hw_iface;       // NIC to switch to hardware RX stamping (SIOCSHWTSTAMP, CAP_NET_ADMIN)
+};
+
+// The TCP socket under the TLS stream. Reads go through recvmsg() when
+// timestamps or quick ACKs are on, so the kernel receive time of the latest
+// segment is kept in `last_rx_ns`. A message assembled from bytes an earlier
+// read already pulled in keeps that earlier (true arrival) time.
+class TimestampedSocket {
+public:
+    using next_layer_type = boost::asio::ip::tcp::socket;
+    using lowest_layer_type = next_layer_type::lowest_layer_type;
+    using executor_type = next_layer_type::executor_type;
+
+    long long last_rx_ns = 0;
+    long long io_ns = 0; // total time spent in read_some(), including waits for data
+
+    explicit TimestampedSocket(boost::asio::io_context& ioc) : sock(ioc) {}
+
+    executor_type get_executor() { return sock.get_executor(); }
+    next_layer_type& next_layer() { return sock; }
+    lowest_layer_type& lowest_layer() { return sock.lowest_layer(); }
+
+    // Call on the opened socket before connecting: the window scale is fixed by
+    // the SYN, so a larger SO_RCVBUF set afterwards cannot be fully used.
+    void apply(const SocketTuning& t) {
+        tuning = t;
+        sock.set_option(boost::asio::ip::tcp::no_delay(t.nodelay));
+        if (t.rcvbuf > 0) {
+            sock.set_option(boost::asio::socket_base::receive_buffer_size(t.rcvbuf));
+            boost::asio::socket_base::receive_buffer_size got;
+            sock.get_option(got);
+            if (got.value() < t.rcvbuf)
+                std::cerr << "[NET] SO_RCVBUF capped at " << got.value() << " bytes (net.core.rmem_max)" << std::endl;
+        }
+#if defined(__linux__)
+        int fd = sock.native_handle();
+        if (t.busy_poll_us > 0 && setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &t.busy_poll_us, sizeof(t.busy_poll_us)) < 0)
+            std::cerr << "[NET] SO_BUSY_POLL: " << std::strerror(errno) << " (needs CAP_NET_ADMIN)" << std::endl;
+        if (t.timestamps == RxTimestamps::NONE) return;
+        int flags = SOF_TIMESTAMPING_SOFTWARE | SOF_TIMESTAMPING_RX_SOFTWARE;
+        if (t.timestamps == RxTimestamps::HARDWARE && enable_hw_stamping(fd, t.hw_iface))
+            flags |= SOF_TIMESTAMPING_RAW_HARDWARE | SOF_TIMESTAMPING_RX_HARDWARE;
+        if (setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags)) < 0) {
+            std::cerr << "[NET] SO_TIMESTAMPING: " << std::strerror(errno) << std::endl;
+            tuning.timestamps = RxTimestamps::NONE;
+        }
+#else
+        tuning.timestamps = RxTimestamps::NONE;
+        tuning.quickack = false;
+#endif
+    }
+
+    template <class MutableBufferSequence>
+    size_t read_some(const MutableBufferSequence& buffers, boost::system::error_code& ec) {
+        auto start = std::chrono::steady_clock::now();
+        size_t n;
+#if defined(__linux__)
+        if (tuning.timestamps != RxTimestamps::NONE || tuning.quickack) n = recv_stamped(buffers, ec);
+        else
+#endif
+        n = sock.read_some(buffers, ec);
+        io_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        return n;
+    }
+
+    template <class MutableBufferSequence>
+    size_t read_some(const MutableBufferSequence& buffers) {
+        boost::system::error_code ec;
+        size_t n = read_some(buffers, ec);
+        if (ec) throw boost::system::system_error(ec);
+        return n;
+    }
+
+    template <class ConstBufferSequence>
+    size_t write_some(const ConstBufferSequence& buffers, boost::system::error_code& ec) { return sock.write_some(buffers, ec); }
+
+    template <class ConstBufferSequence>
+    size_t write_some(const ConstBufferSequence& buffers) { return sock.write_some(buffers); }
+
+    // Asynchronous reads skip the timestamps; the engine reads synchronously.
+    template <class MutableBufferSequence, class Handler>
+    auto async_read_some(const MutableBufferSequence& buffers, Handler&& handler) {
+        return sock.async_read_some(buffers, std::forward<Handler>(handler));
+    }
+
+    template <class ConstBufferSequence, class Handler>
+    auto async_write_some(const ConstBufferSequence& buffers, Handler&& handler) {
+        return sock.async_write_some(buffers, std::forward<Handler>(handler));
+    }
+
+private:
+#if defined(__linux__)
+    template <class MutableBufferSequence>
+    size_t recv_stamped(const MutableBufferSequence& buffers, boost::system::error_code& ec) {
+        iovec iov[8];
+        size_t n = 0;
+        for (auto it = boost::asio::buffer_sequence_begin(buffers); it != boost::asio::buffer_sequence_end(buffers) && n < 8; ++it) {
+            boost::asio::mutable_buffer b = *it;
+            iov[n++] = {b.data(), b.size()};
+        }
+        alignas(cmsghdr) char control[256];
+        msghdr msg{};
+        msg.msg_iov = iov;
+        msg.msg_iovlen = n;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+
+        int fd = sock.native_handle();
+        ssize_t r;
+        while ((r = recvmsg(fd, &msg, 0)) < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) { // Asio may have left the fd non-blocking
+                pollfd p{fd, POLLIN, 0};
+                poll(&p, 1, -1);
+                continue;
+            }
+            ec.assign(errno, boost::system::system_category());
+            return 0;
+        }
+        if (r == 0 && n > 0 && iov[0].iov_len > 0) { ec = boost::asio::error::eof; return 0; }
+        ec = {};
+
+        for (cmsghdr* c = CMSG_FIRSTHDR(&msg); c; c = CMSG_NXTHDR(&msg, c)) {
+            if (c->cmsg_level != SOL_SOCKET || c->cmsg_type != SO_TIMESTAMPING) continue;
+            scm_timestamping ts;
+            std::memcpy(&ts, CMSG_DATA(c), sizeof(ts));
+            // ts[2] is the NIC's clock: only comparable to ours when phc2sys keeps them in step
+            const timespec& t = (ts.ts[2].tv_sec || ts.ts[2].tv_nsec) ? ts.ts[2] : ts.ts[0];
+            if (t.tv_sec || t.tv_nsec) last_rx_ns = (long long)t.tv_sec * 1000000000LL + t.tv_nsec;
+        }
+        if (tuning.quickack) {
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_QUICKACK, &one, sizeof(one));
+        }
+        return (size_t)r;
+    }
+
+    static bool enable_hw_stamping(int fd, const std::string& iface) {
+        hwtstamp_config cfg{};
+        cfg.tx_type = HWTSTAMP_TX_OFF;
+        cfg.rx_filter = HWTSTAMP_FILTER_ALL;
+        ifreq ifr{};
+        std::strncpy(ifr.ifr_name, iface.c_str(), IFNAMSIZ - 1);
+        ifr.ifr_data = reinterpret_cast<char*>(&cfg);
+        if (iface.empty() || ioctl(fd, SIOCSHWTSTAMP, &ifr) < 0) {
+            std::cerr << "[NET] Hardware RX stamping unavailable on '" << iface << "'"
+                      << (iface.empty() ? "" : std::string(": ") + std::strerror(errno)) << "; using software" << std::endl;
+            return false;
+        }
+        return true;
+    }
+#endif
+
+    next_layer_type sock;
+    SocketTuning tuning;
+};
+
+// --- 2. ASIO (DEFAULT) ---
+class AsioFeed {
+public:
+    // REST snapshots are fetched separately; the stream carries only depth updates.
+    static constexpr bool IN_BAND_SNAPSHOTS = false;
+
+    // Per message: time in ws.read() outside the socket reads, i.e. TLS record
+    // decryption plus WebSocket framing.
+    RxLatency decode;
+
+    AsioFeed(boost::asio::io_context& ioc, boost::asio::ssl::context& ctx, const SocketTuning& tuning = {})
+        : resolver(ioc), ws(ioc, ctx), tuning(tuning) {}
+
+    void connect(const std::string& host, const std::string& port, const std::string& target) {
+        namespace websocket = boost::beast::websocket;
+        auto const results = resolver.resolve(host, port);
+        // Not boost::asio::connect: it would reopen the socket and drop the tuning
+        auto& sock = socket().next_layer();
+        boost::system::error_code ec = boost::asio::error::host_not_found;
+        for (const auto& entry : results) {
+            sock.close(ec);
+            sock.open(entry.endpoint().protocol());
+            socket().apply(tuning);
+            sock.connect(entry.endpoint(), ec);
+            if (!ec) break;
+        }
+        if (ec) throw boost::system::system_error(ec, "connect");
+        tls_handshake(ws.next_layer(), host, "stream");
+        ws.set_option(websocket::stream_base::decorator([](websocket::request_type& req) {
+            req.set(boost::beast::http::field::user_agent, "HFT-Client/1.0");
+        }));
+        // Not offered, so frames arrive uncompressed and need no inflate buffer
+        websocket::permessage_deflate pmd;
+        pmd.client_enable = false;
+        ws.set_option(pmd);
+        // The padding at the end of `buffer` stays free: a longer message fails the read
+        ws.read_message_max(MAX_MESSAGE);
+        ws.handshake(host + ":" + port, target);
+    }
+
+    // Blocks for the next message. The receive time is the kernel's when
+    // timestamping is on, else the moment Beast returns (after TLS decryption).
+    // Payloads are decrypted straight into `buffer`, which restarts at its
+    // beginning after every consume(); Beast only stages frame headers itself.
+    std::string_view read(long long& rx_ns) {
+        buffer.consume(buffer.size());
+        long long io_before = socket().io_ns;
+        auto start = std::chrono::steady_clock::now();
+        ws.read(buffer);
+        long long read_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        decode.add(0, read_ns - (socket().io_ns - io_before));
+        rx_ns = socket().last_rx_ns ? socket().last_rx_ns : wall_ns();
+        auto data = buffer.cdata();
+        return {static_cast<const char*>(data.data()), data.size()};
+    }
+
+    bool padded() const { return true; }
+
+    // Bytes already queued on the socket. A lower bound, since frames Beast or
+    // OpenSSL already pulled in are not visible here.
+    size_t queued() {
+        boost::beast::error_code ec;
+        size_t n = boost::beast::get_lowest_layer(ws).available(ec);
+        return ec ? 0 : n;
+    }
+
+private:
+    TimestampedSocket& socket() { return ws.next_layer().next_layer(); }
+
+    boost::asio::ip::tcp::resolver resolver;
+    boost::beast::websocket::stream<boost::beast::ssl_stream<TimestampedSocket>> ws;
+    boost::beast::flat_static_buffer<MAX_MESSAGE + simdjson::SIMDJSON_PADDING> buffer;
+    SocketTuning tuning;
+};
+
+// --- 3. PACKET-MMAP RING (LINUX) ---
+#if defined(__linux__)
+class PacketRingFeed {
+public:
+    // Snapshots arrive as ordinary datagrams ({"lastUpdateId":...}); there is no REST side channel,
+    // so the sender must repeat them: after a gap or a late start the book stays invalid until the next one.
+    static constexpr bool IN_BAND_SNAPSHOTS = true;
+    static constexpr unsigned FRAME_SIZE = 4096;  // one page: a 1500-byte MTU frame plus the tpacket header
+    static constexpr unsigned FRAMES = 4096;      // 16 MB ring, absorbs bursts while the engine is busy
+
+    // Counters (written only by the reading thread)
+    long long received = 0;
+    long long ignored = 0;    // frames that are not UDP to our port
+    long long truncated = 0;  // larger than FRAME_SIZE, or IP fragments
+
+    // read() gives up (returns an empty view) once `stop` is set, since it would otherwise spin forever on a quiet port.
+    PacketRingFeed(const std::string& iface, uint16_t port, const std::atomic<bool>* stop = nullptr) : port(port), stop(stop) {
+        fd = socket(AF_PACKET, SOCK_RAW, htons(ETH_P_IP));
+        if (fd < 0) throw std::runtime_error("packet socket: " + std::string(std::strerror(errno)) + " (needs CAP_NET_RAW)");
+        int version = TPACKET_V2;
+        tpacket_req req{};
+        req.tp_block_size = FRAME_SIZE;
+        req.tp_block_nr = FRAMES;
+        req.tp_frame_size = FRAME_SIZE;
+        req.tp_frame_nr = FRAMES;
+        if (setsockopt(fd, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) < 0 ||
+            setsockopt(fd, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req)) < 0) {
+            fail("PACKET_RX_RING");
+        }
+        void* m = mmap(nullptr, size_t(FRAME_SIZE) * FRAMES, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (m == MAP_FAILED) fail("mmap");
+        ring = static_cast<uint8_t*>(m);
+
+        sockaddr_ll addr{};
+        addr.sll_family = AF_PACKET;
+        addr.sll_protocol = htons(ETH_P_IP);
+        addr.sll_ifindex = (int)if_nametoindex(iface.c_str());
+        if (addr.sll_ifindex == 0 || bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) fail("bind " + iface);
+    }
+
+    ~PacketRingFeed() {
+        if (ring) munmap(ring, size_t(FRAME_SIZE) * FRAMES);
+        if (fd >= 0) close(fd);
+    }
+
+    PacketRingFeed(const PacketRingFeed&) = delete;
+    PacketRingFeed& operator=(const PacketRingFeed&) = delete;
+
+    // Spins until the next datagram for our port (or `stop`). The view points into the ring
+    // frame, which goes back to the kernel on the following read().
+    std::string_view read(long long& rx_ns) {
+        release();
+        while (true) {
+            tpacket2_hdr* h = frame(head);
+            if (!(__atomic_load_n(&h->tp_status, __ATOMIC_ACQUIRE) & TP_STATUS_USER)) {
+                if (stop && stop->load(std::memory_order_relaxed)) return {};
+                continue;
+            }
+            held = true;
+            std::string_view payload;
+            if (udp_payload(h, payload)) {
+                received++;
+                rx_ns = (long long)h->tp_sec * 1000000000LL + h->tp_nsec; // kernel receive time
+                return payload;
+            }
+            release();
+        }
+    }
+
+    // Datagrams near a full frame leave less than the padding before the frame ends.
+    bool padded() const { return payload_padded; }
+
+    // Frame bytes already in the ring behind the current message.
+    size_t queued() {
+        size_t bytes = 0;
+        for (unsigned i = head + 1; i < head + FRAMES; i++) {
+            tpacket2_hdr* h = frame(i % FRAMES);
+            if (!(__atomic_load_n(&h->tp_status, __ATOMIC_ACQUIRE) & TP_STATUS_USER)) break;
+            bytes += h->tp_snaplen;
+        }
+        return bytes;
+    }
+
+private:
+    tpacket2_hdr* frame(unsigned i) const { return reinterpret_cast<tpacket2_hdr*>(ring + size_t(i) * FRAME_SIZE); }
+
+    void release() {
+        if (!held) return;
+        __atomic_store_n(&frame(head)->tp_status, TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+        head = (head + 1) % FRAMES;
+        held = false;
+    }
+
+    bool udp_payload(tpacket2_hdr* h, std::string_view& payload) {
+        const uint8_t* ip_bytes = reinterpret_cast<const uint8_t*>(h) + h->tp_net;
+        size_t len = h->tp_snaplen - (h->tp_net - h->tp_mac);
+        if (len < sizeof(iphdr)) { ignored++; return false; }
+        iphdr ip;
+        std::memcpy(&ip, ip_bytes, sizeof(ip));
+        size_t ihl = ip.ihl * 4u;
+        if (ip.protocol != IPPROTO_UDP || len < ihl + sizeof(udphdr)) { ignored++; return false; }
+        udphdr udp;
+        std::memcpy(&udp, ip_bytes + ihl, sizeof(udp));
+        if (ntohs(udp.dest) != port) { ignored++; return false; }
+        size_t udp_len = ntohs(udp.len);
+        if ((ntohs(ip.frag_off) & (IP_MF | IP_OFFMASK)) || h->tp_snaplen < h->tp_len ||
+            udp_len < sizeof(udphdr) || ihl + udp_len > len) {
+            truncated++;
+            return false;
+        }
+        payload = {reinterpret_cast<const char*>(ip_bytes + ihl + sizeof(udphdr)), udp_len - sizeof(udphdr)};
+        size_t end = payload.data() + payload.size() - reinterpret_cast<const char*>(h);
+        payload_padded = end + simdjson::SIMDJSON_PADDING <= FRAME_SIZE;
+        return true;
+    }
+
+    [[noreturn]] void fail(const std::string& what) {
+        std::string msg = "packet ring: " + what + ": " + std::strerror(errno);
+        if (ring) munmap(ring, size_t(FRAME_SIZE) * FRAMES);
+        close(fd);
+        throw std::runtime_error(msg);
+    }
+
+    int fd = -1;
+    uint8_t* ring = nullptr;
+    unsigned head = 0;
+    bool held = false;
+    bool payload_padded = false;
+    uint16_t port;
+    const std::atomic<bool>* stop;
+};
+#endif
+
+// --- 4. RECORDED REPLAY ---
+// Recorded REST snapshots come back in-band; validator checkpoints ({"chk":..})
+// are skipped. Receive time is the time of the read, so kernel->read is ~0.
+class ReplayFeed {
+public:
+    static constexpr bool IN_BAND_SNAPSHOTS = true;
+
+    explicit ReplayFeed(const std::string& path) {
+        if (!reader.open(path)) throw std::runtime_error("replay: cannot read " + path);
+    }
+
+    // An empty view once the recording is exhausted
+    std::string_view read(long long& rx_ns) {
+        std::string_view line, json;
+        while (reader.next(line)) {
+            split_record(line, json);
+            if (json.empty() || json.starts_with("{\"chk\"")) continue;
+            rx_ns = wall_ns();
+            messages++;
+            return json;
+        }
+        done = true;
+        return {};
+    }
+
+    bool exhausted() const { return done; }
+    bool padded() const { return reader.padded(); }
+    size_t queued() { return 0; }
+
+    long long messages = 0;
+
+private:
+    RecordingReader reader;
+    bool done = false;
+};